@@ -0,0 +1,85 @@
+#include "mpi.h"
+#include "restart.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define MULT 20
+#define PAGES 4096
+
+int print_to_file(double, int, int, FILE*, char*);
+
+// Touches one page every stride, then commits; with CHECKPOINT_DIRTY_PAGES Off every commit
+// is a full copy, so comparing the two builds gives the gain of the incremental checkpoint
+double measure(char* data, long page_size, int stride, size_t* bytes)
+{
+    double start = MPI_Wtime();
+    for(int i = 0; i < MULT; i++)
+    {
+        for(int page = 0; page < PAGES; page += stride)
+            data[page * page_size] += 1;
+        legio_checkpoint_commit();
+        *bytes += legio_checkpoint_bytes();
+    }
+    // Include the transfer of the last commit
+    MPI_Barrier(MPI_COMM_WORLD);
+    return MPI_Wtime() - start;
+}
+
+int main(int argc, char** argv)
+{
+    int rank, size;
+    MPI_Init(&argc, &argv);
+
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    FILE* file_p;
+
+    if(rank == 1)
+    {
+        file_p = fopen("checkpoint.csv", "w");
+    }
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    char* data = legio_checkpoint_alloc(PAGES * page_size);
+    for(int page = 0; page < PAGES; page++)
+        data[page * page_size] = rank;
+    legio_checkpoint_commit();
+
+    int strides[4] = {1, 10, 100, PAGES};
+    char* names[4] = {"all pages", "10% pages", "1% pages", "one page"};
+    char label[64];
+    for(int i = 0; i < 4; i++)
+    {
+        size_t bytes = 0;
+        double elapsed = measure(data, page_size, strides[i], &bytes);
+        print_to_file(elapsed / MULT, rank, size, file_p, names[i]);
+        sprintf(label, "%s bytes", names[i]);
+        print_to_file((double)bytes / MULT, rank, size, file_p, label);
+    }
+
+    if(rank == 1)
+        fclose(file_p);
+
+    MPI_Finalize();
+
+    return MPI_SUCCESS;
+}
+
+int print_to_file(double result, int rank, int size, FILE* file_p, char* to_be_printed)
+{
+    MPI_Barrier(MPI_COMM_WORLD);
+    double send_buf = result;
+    double recv_buf;
+    double recv_buf2;
+    MPI_Reduce(&send_buf, &recv_buf, 1, MPI_DOUBLE, MPI_SUM, 1, MPI_COMM_WORLD);
+    MPI_Reduce(&send_buf, &recv_buf2, 1, MPI_DOUBLE, MPI_MAX, 1, MPI_COMM_WORLD);
+    if(rank == 1)
+    {
+        recv_buf /= size;
+        fprintf(file_p, "%s, %f, %f\n", to_be_printed, recv_buf, recv_buf2);
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    return 0;
+}
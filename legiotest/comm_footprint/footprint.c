@@ -0,0 +1,55 @@
+#include "mpi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define ROUNDS 10
+#define BATCH 1000
+
+// Resident memory of the process in KiB, as reported by /proc/self/statm
+long resident_kib()
+{
+    long pages = 0, resident = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL)
+        return -1;
+    if (fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+        resident = -1;
+    fclose(statm);
+    return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Creates and frees short-lived comms in a loop: the footprint must stay flat across the rounds
+int main(int argc, char** argv)
+{
+    int size, rank, round, i;
+    long local, max;
+    MPI_Comm temp;
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    if (rank == 0)
+        printf("round, max resident KiB, seconds\n");
+    for (round = 0; round < ROUNDS; round++)
+    {
+        double start = MPI_Wtime();
+        for (i = 0; i < BATCH; i++)
+        {
+            if (i % 2)
+                MPI_Comm_split(MPI_COMM_WORLD, rank % 2, rank, &temp);
+            else
+                MPI_Comm_dup(MPI_COMM_WORLD, &temp);
+            MPI_Comm_free(&temp);
+        }
+        double end = MPI_Wtime();
+        local = resident_kib();
+        MPI_Reduce(&local, &max, 1, MPI_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+        if (rank == 0)
+            printf("%d, %ld, %f\n", round, max, end - start);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
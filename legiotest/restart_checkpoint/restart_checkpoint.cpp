@@ -0,0 +1,48 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "mpi.h"
+extern "C" {
+#include "restart.h"
+}
+
+#define ITERATIONS 10
+#define FAIL_AT 6
+#define COUNT 1024
+
+// Run with `-n 3 --to-respawn 0`: rank 0 fails and resumes from its last checkpoint
+int main(int argc, char** argv)
+{
+    int rank, size, i, iteration = 0;
+    double data[COUNT];
+    MPI_Init(&argc, &argv);
+
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    for (i = 0; i < COUNT; i++)
+        data[i] = rank;
+    legio_checkpoint_register(&iteration, sizeof(int));
+    legio_checkpoint_register(data, sizeof(double) * COUNT);
+
+    if (is_respawned())
+        printf("Rank %d restored generation %d at iteration %d\n", rank,
+               legio_checkpoint_generation(), iteration);
+
+    for (; iteration < ITERATIONS;)
+    {
+        for (i = 0; i < COUNT; i++)
+            data[i] += 1.0;
+        iteration++;
+        legio_checkpoint_commit();
+        if (!is_respawned() && rank == 0 && iteration == FAIL_AT)
+            raise(SIGINT);
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    if (data[0] != rank + ITERATIONS)
+        printf("Rank %d: wrong value %f after restore\n", rank, data[0]);
+    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Finalize();
+}
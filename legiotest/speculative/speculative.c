@@ -0,0 +1,57 @@
+#include "mpi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include "legio.h"
+
+#define ITERATIONS 10
+
+// Build with SPECULATIVE_COLLECTIVES=On: the iterations from the one whose sum was found failed
+// are computed again
+int calls = 0, to_redo = -1;
+int iteration_of[2 * ITERATIONS + 2];
+
+void rollback(MPI_Comm comm, int epoch)
+{
+    printf("Speculative collective %d failed, redoing from iteration %d\n", epoch,
+           iteration_of[epoch]);
+    to_redo = iteration_of[epoch];
+}
+
+int main(int argc, char** argv)
+{
+    int size, rank, iteration, local, sum = 0;
+
+    MPI_Init(&argc, &argv);
+    MPIX_Rollback_handler_set(rollback);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    int* sums = calloc(ITERATIONS, sizeof(int));
+    for (iteration = 0; iteration < ITERATIONS; iteration++)
+    {
+        if (rank == size - 1 && iteration == ITERATIONS / 2)
+            raise(SIGINT);
+        local = rank * iteration;
+        // Epochs count the speculative collectives on the comm, starting from 1
+        iteration_of[++calls] = iteration;
+        MPI_Allreduce(&local, &sums[iteration], 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+        if (to_redo >= 0)
+        {
+            iteration = to_redo - 1;
+            to_redo = -1;
+        }
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    if (rank == 0)
+    {
+        for (iteration = 0; iteration < ITERATIONS; iteration++)
+            sum += sums[iteration];
+        printf("Sum over all the iterations: %d\n", sum);
+    }
+
+    free(sums);
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,147 @@
+#ifndef CHECKPOINT_MANAGER_HPP
+#define CHECKPOINT_MANAGER_HPP
+
+#include <cstddef>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "config.hpp"
+#include "mpi.h"
+
+namespace legio {
+
+// In-memory buddy checkpointing: each rank mirrors its registered regions into the next alive
+// world rank, so that a respawned rank gets back its last committed state from there
+class CheckpointManager
+{
+   public:
+    CheckpointManager(CheckpointManager const&) = delete;
+    CheckpointManager& operator=(CheckpointManager const&) = delete;
+    CheckpointManager() = default;
+
+    // Regions are stored in registration order; on a respawned rank the restored content is
+    // copied back into each region as soon as it is registered
+    void register_region(void* buf, const std::size_t size);
+    // Page-aligned region owned by Legio, registered as above; with CHECKPOINT_DIRTY_PAGES only
+    // these regions are tracked, the others are sent in full by every commit
+    void* allocate_region(const std::size_t size);
+    // Called by the wrappers before MPI may write into buf: the kernel does not fault on those
+    // writes, so a tracked region holding buf is unprotected and sent in full from then on
+    inline void expose(const void* buf)
+    {
+        if constexpr (BuildOptions::checkpoint_dirty_pages)
+            untrack(buf);
+    }
+    // Collective over the world, the transfer to the buddy overlaps with the computation
+    void commit();
+    // Keeps a shadowing replica on the generation of its primary
+    inline void skip_commit() { generation++; }
+    // Collective over the world after a respawn: the buddies of the respawned ranks send them
+    // the checkpoints they hold
+    void restore(const std::vector<int>& respawned);
+    // Waits for the transfer of the last commit, also called by the repair thread
+    void wait_pending();
+    bool is_pending();
+    // Waits for the transfers and the flush, then closes the checkpoint files
+    void close();
+    // Unmaps and removes the shared memory segment of this rank
+    void release_shared_state();
+
+    // Identifier of the job shared by all its incarnations, names the shared memory segments
+    inline const std::string& get_job_key() const { return job_key; }
+    inline void set_job_key(const std::string& key) { job_key = key; }
+    // Job id given by the launcher, or the host and pid of this process if none is found
+    static std::string launcher_job_key();
+
+    inline int get_generation() const { return generation; }
+    // Generation restored by a rank respawned in the last restore, 0 if none
+    int get_restored_generation(const int world_rank) const;
+    inline std::size_t get_last_bytes() const { return last_bytes; }
+
+   private:
+    struct Region
+    {
+        char* buf;
+        std::size_t size;
+        // Offset of the region inside the checkpoint image
+        std::size_t image_offset;
+        // Entry of the region in the table of the fault handler, -1 if its pages are not tracked
+        int tracked;
+    };
+
+    // Commit message layout: header, (offset, length) pairs inside the image, then the data
+    struct Header
+    {
+        int generation;
+        int full;
+        std::size_t total;
+        std::size_t chunks;
+    };
+
+    // Checkpoint file layout: header, then the image
+    struct FileHeader
+    {
+        int generation;
+        std::size_t size;
+    };
+
+    static int own_world_rank();
+    static int buddy_of(const int world_rank);
+    static int ward_of(const int world_rank);
+    void transfer(MPI_Comm comm, const int buddy, const int ward, const int ward_world_rank);
+    void apply(const std::vector<char>& message, const int ward_world_rank);
+    static void patch(char* image, const std::vector<char>& message);
+    void add_region(void* buf, const std::size_t size, const int tracked);
+    void untrack(const void* buf);
+    void protect_regions();
+    void start_flush();
+    void flush();
+    void read_from_disk();
+    static std::string file_name(const int slot);
+    char* own_image_data();
+    void map_shared_state(const bool create);
+    std::string shared_state_name(const int world_rank) const;
+
+    std::vector<Region> regions;
+    std::size_t image_size = 0;
+    int generation = 0;
+    // Own last commit, kept alive while being sent
+    std::vector<char> staging;
+    std::size_t last_bytes = 0;
+    // A full image is needed for a new buddy or after a respawn
+    int last_buddy = -1;
+    bool force_full = true;
+    // Last complete checkpoint received from the ward, prefixed by its generation
+    std::vector<char> held;
+    int held_rank = -1;
+    // State received after a respawn, consumed by register_region
+    std::vector<char> restored;
+    std::size_t restored_offset = 0;
+    std::future<void> pending;
+    // The user thread commits while the repair thread may join the transfer
+    std::mutex pending_lock;
+    // Generations restored by the ranks of the last restore
+    std::map<int, int> restored_generations;
+    // Own image, kept up to date with the commits to feed the flush to disk; with
+    // CHECKPOINT_SHM it lives in a shared memory segment that outlives a crash of the process
+    std::vector<char> own_image;
+    FileHeader* shared_state = nullptr;
+    std::size_t shared_state_size = 0;
+    // Kept aside since the segment is removed after MPI is finalized
+    std::string shared_state_path;
+    std::string job_key;
+    // Set after the first mapping failure, the own image then stays in private memory
+    bool shared_state_disabled = false;
+    // Second buffer, written to disk by the I/O task while the computation goes on
+    std::vector<char> flush_buffer;
+    int flush_generation = 0;
+    std::future<void> flushing;
+    // Files alternate between generations, so a torn write never hides the previous one
+    MPI_File slots[2] = {MPI_FILE_NULL, MPI_FILE_NULL};
+};
+
+}  // namespace legio
+
+#endif
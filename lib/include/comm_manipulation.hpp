@@ -1,17 +1,48 @@
 #ifndef COMM_MANIPULATION_HPP
 #define COMM_MANIPULATION_HPP
 
+#include <vector>
+#include "mpi.h"
+
 namespace legio {
 
 class ComplexComm;
 
 int translate_ranks(int, ComplexComm&);
 
-void replace_comm(ComplexComm&);
+// Replaces the comm unless it was already replaced since version, read by the caller before the
+// failed call
+void replace_comm(ComplexComm&, const int version);
 
 void replace_and_repair_comm(ComplexComm& cur_complex);
 
-void agree_and_eventually_replace(int*, ComplexComm&);
+void agree_and_eventually_replace(int*, ComplexComm&, const int version);
+
+// Stops handling comm after legio_unmanaged is set on it: the user handle, still a valid comm,
+// goes straight to the MPI library from now on
+void release_comm(MPI_Comm comm);
+
+// LAZY_AGREEMENT and SPECULATIVE_COLLECTIVES counterpart of agree_and_eventually_replace: the
+// agreement is left pending and the failed collective is reported instead of retried, as the
+// other ranks have moved on
+int agree_lazily(const int rc, ComplexComm&, const bool speculative = false);
+
+// Completes the agreement pending on the comm, replacing it if any rank failed and then calling
+// the rollback handler for speculative collectives; without wait it only checks if it is over
+void complete_agreement(ComplexComm&, const bool wait);
+
+// Handler called with the alias comm and the epoch of a failed speculative collective
+void set_rollback_handler(void (*handler)(MPI_Comm, int));
+
+// Ranks of comm whose failure has been acknowledged locally
+std::vector<int> acked_failures(MPI_Comm comm);
+
+// Waits until no new failure of comm is acknowledged for FAILURE_SETTLE_WINDOW milliseconds, so
+// that failures discovered close together are folded into a single shrink
+void settle_failures(MPI_Comm comm);
+
+// Ranks of comm that are not part of shrunk, the same on every process after a shrink
+std::vector<int> excluded_ranks(MPI_Comm comm, MPI_Comm shrunk);
 
 void initialization(int* argc, char*** argv);
 
@@ -1,10 +1,16 @@
 #ifndef COMPLEX_COMM_HPP
 #define COMPLEX_COMM_HPP
 
+#include <atomic>
 #include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
+#include "group_cache.hpp"
 #include "mpi.h"
+#include "resiliency_policy.hpp"
 #include "struct_selector.hpp"
 #include "structure_handler.hpp"
 
@@ -57,16 +63,50 @@ class ComplexComm
     MPI_Group get_group();
     MPI_Comm get_alias();
     int get_alias_id() { return alias_id; }
+    GroupCache& get_group_cache() { return *checked_groups; }
+    // Called by replace_comm only, a point all the ranks of the comm go through
+    void advance_failure_epoch() { checked_groups->advance_epoch(); }
+    // Held shared by the MPI calls on the comm and exclusively while it is being repaired, so
+    // that a repair only stops the threads using the affected comms
+    void lock_shared() { comm_mtx->lock_shared(); }
+    void unlock_shared() { comm_mtx->unlock_shared(); }
+    void lock() { comm_mtx->lock(); }
+    void unlock() { comm_mtx->unlock(); }
+    // Advanced by every replacement of the comm
+    int get_version() const { return version->load(); }
+    ResiliencyPolicy& get_policy() { return policy; }
+    // Agreement on the outcome of the last collective, left pending with LAZY_AGREEMENT or
+    // SPECULATIVE_COLLECTIVES; speculative ones are numbered by epoch, starting from 1
+    void start_agreement(const int flag, const bool speculative);
+    // False while the agreement is still running, it is only waited for if wait is set; flag is
+    // its outcome, or true if no agreement was pending; epoch is 0 if it was not speculative;
+    // version is the one of the comm the agreement ran on
+    bool finish_agreement(const bool wait, int* flag, int* epoch, int* version);
 
    private:
     handlers struct_handlers;
     MPI_Comm cur_comm;
-    MPI_Group group;
+    // Group of the comm when it was added, freed with the last copy
+    std::shared_ptr<MPI_Group> group;
     int alias_id;
+    std::shared_ptr<GroupCache> checked_groups;
+    std::shared_ptr<std::shared_timed_mutex> comm_mtx;
+    std::shared_ptr<std::atomic<int>> version;
+    struct PendingAgreement
+    {
+        std::mutex lock;
+        MPI_Request request = MPI_REQUEST_NULL;
+        int flag;
+        bool speculative = false;
+        int epoch = 0;
+        int version = 0;
+    };
+    std::shared_ptr<PendingAgreement> agreement;
+    ResiliencyPolicy policy;
     template <class MPI_T>
     inline StructureHandler<MPI_T, MPI_Comm>* get_handler(void)
     {
-        return std::get<handle_selector<MPI_T>::get()>(struct_handlers);
+        return std::get<handle_selector<MPI_T>::get()>(struct_handlers).get();
     }
 };
 
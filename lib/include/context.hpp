@@ -1,8 +1,11 @@
 #ifndef CONTEXT_HPP
 #define CONTEXT_HPP
 
+#include "checkpoint_manager.hpp"
 #include "config.hpp"
+#include "message_log.hpp"
 #include "multicomm.hpp"
+#include "replica_manager.hpp"
 #include "restart_manager.hpp"
 #if WITH_SESSION
 #include "session_manager.hpp"
@@ -26,6 +29,9 @@ class Context
 #endif
     Multicomm m_comm;
     RestartManager r_manager;
+    CheckpointManager c_manager;
+    MessageLog m_log;
+    ReplicaManager rep_manager;
 
    private:
     Context() = default;
@@ -0,0 +1,45 @@
+#ifndef GROUP_CACHE_HPP
+#define GROUP_CACHE_HPP
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include "mpi.h"
+
+namespace legio {
+
+// Groups already cleaned from failures, tagged with the failure epoch of the validation.
+// An entry is only valid in its own epoch; epochs advance at the replacements of the comm, that
+// every rank goes through, so that all the members of a group take the same path. The cache is
+// not bounded: an eviction would be local to a rank, and the members would diverge again.
+class GroupCache
+{
+   public:
+    GroupCache(GroupCache const&) = delete;
+    GroupCache& operator=(GroupCache const&) = delete;
+    GroupCache() = default;
+    ~GroupCache();
+
+    // Ranks of the members of group inside reference, used as key
+    static std::vector<int> signature(MPI_Group group, MPI_Group reference);
+
+    bool find(const std::vector<int>& signature, MPI_Group* clean);
+    // Ownership of clean is taken by the cache
+    void insert(const std::vector<int>& signature, MPI_Group clean);
+    void advance_epoch();
+    unsigned long get_epoch();
+
+   private:
+    struct Entry
+    {
+        unsigned long epoch;
+        MPI_Group clean;
+    };
+    std::mutex lock;
+    std::map<std::vector<int>, Entry> entries;
+    unsigned long epoch = 0;
+};
+
+}  // namespace legio
+
+#endif
@@ -3,19 +3,33 @@
 
 #include "mpi.h"
 
-#define LEGIO_MAX_FAILS 50
 #define LEGIO_FAILURE_TAG 77
 #define LEGIO_PING_TAG 78
+#define LEGIO_SPARE_TAG 79
+#define LEGIO_CHECKPOINT_TAG 80
+#define LEGIO_CHECKPOINT_REQUEST_TAG 81
+#define LEGIO_REPLICA_TAG 82
 #define LEGIO_FAILURE_PING_VALUE 1
 #define LEGIO_FAILURE_REPAIR_VALUE 2
 #define LEGIO_FAILURE_REPAIR_SELF_VALUE 3
+#define LEGIO_SPARE_REPAIR_VALUE 4
+#define LEGIO_SPARE_RELEASE_VALUE 5
+#define LEGIO_RESPAWN_VALUE 6
+#define LEGIO_REPLICA_PROMOTE_VALUE 7
+#define LEGIO_REPLICA_RELEASE_VALUE 8
 
 void fault_number(MPI_Comm, int*);
 
+// ranks must have room for the number of failures given by fault_number
 void who_failed(MPI_Comm, int*, int*);
 
 int MPIX_Comm_agree_group(MPI_Comm, MPI_Group, int*);
 
+// With SPECULATIVE_COLLECTIVES, called with the comm and the epoch (the count of speculative
+// collectives on the comm) of a collective whose validation found a failure
+typedef void(MPIX_Rollback_function)(MPI_Comm, int);
+int MPIX_Rollback_handler_set(MPIX_Rollback_function*);
+
 int MPIX_Horizon_from_group(MPI_Group);
 
 #endif
@@ -0,0 +1,65 @@
+#ifndef MESSAGE_LOG_HPP
+#define MESSAGE_LOG_HPP
+
+#include <cstddef>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+#include "complex_comm.hpp"
+#include "mpi.h"
+
+namespace legio {
+
+// Sender-based log of the point-to-point messages directed to critical ranks, replayed to
+// their new incarnation after a respawn. Only MPI_COMM_WORLD and the supported comms are
+// logged, since they are the only ones rebuilt for the respawned ranks.
+class MessageLog
+{
+   public:
+    MessageLog(MessageLog const&) = delete;
+    MessageLog& operator=(MessageLog const&) = delete;
+    MessageLog() = default;
+
+    // dest is the rank inside the alias of comm
+    void record(const void* buf,
+                int count,
+                MPI_Datatype datatype,
+                int dest,
+                int tag,
+                ComplexComm& comm);
+    // Drops the messages that a restored checkpoint of the given generation already covers
+    void trim(const int generation);
+    // Sends again to each respawned rank the messages logged after its restored generation
+    void replay(const std::vector<int>& respawned);
+    // Drops the messages sent on a comm that is being freed, they cannot be replayed anymore
+    void forget(MPI_Comm alias);
+
+   private:
+    struct Entry
+    {
+        MPI_Comm alias;
+        int dest;
+        int tag;
+        int generation;
+        std::vector<char> packed;
+    };
+
+    int to_world_rank(const int dest, ComplexComm& comm);
+    void complete_replays();
+
+    // Indexed by world rank of the destination, oldest first
+    std::map<int, std::deque<Entry>> entries;
+    std::map<int, std::size_t> logged_bytes;
+    // Peers whose oldest messages are being dropped since the last trim
+    std::set<int> overflowing;
+    // Replayed messages still in flight, with their buffers
+    std::list<std::pair<MPI_Request, std::vector<char>>> replaying;
+    std::mutex lock;
+};
+
+}  // namespace legio
+
+#endif
@@ -9,8 +9,11 @@
 #include <set>
 #include <unordered_map>
 #include <vector>
+#include "comm_manipulation.hpp"
 #include "complex_comm.hpp"
+#include "config.hpp"
 #include "mpi.h"
+#include "resiliency_policy.hpp"
 #include "struct_selector.hpp"
 #include "supported_comm.hpp"
 
@@ -25,10 +28,21 @@ class Multicomm
     Multicomm& operator=(Multicomm&&) = default;
     Multicomm() = default;
 
-    int add_comm(MPI_Comm);
+    // Duplicates and splits get the policy of their parent
+    int add_comm(MPI_Comm, const ResiliencyPolicy& policy = ResiliencyPolicy());
     ComplexComm& translate_into_complex(MPI_Comm);
     void remove(MPI_Comm, std::function<int(MPI_Comm*)>);
     const bool part_of(const MPI_Comm) const;
+    // Build options for comms not handled by Legio
+    const ResiliencyPolicy& get_policy(const MPI_Comm);
+    // Held around the MPI calls on comm, that only wait while comm itself is being repaired
+    void lock_shared(const MPI_Comm);
+    void unlock_shared(const MPI_Comm);
+    // As above on a comm already looked up: with wait the agreement pending on it is completed,
+    // otherwise only progressed
+    void lock_shared(ComplexComm&, const bool wait);
+    // Waits for the agreements still pending, before MPI is finalized
+    void wait_agreements();
 
     template <class MPI_T>
     bool add_structure(ComplexComm& comm,
@@ -74,6 +88,22 @@ class Multicomm
         return result != maps[handle_selector<MPI_T>::get()].end();
     }
 
+    template <class MPI_T>
+    void lock_shared(MPI_T elem)
+    {
+        if (!part_of(elem))
+            return;
+        // Waiting on a request also progresses the agreement pending on its comm
+        lock_shared(get_complex_from_structure(elem), false);
+    }
+
+    template <class MPI_T>
+    void unlock_shared(MPI_T elem)
+    {
+        if (part_of(elem))
+            get_complex_from_structure(elem).unlock_shared();
+    }
+
    private:
     std::unordered_map<int, ComplexComm> comms;
     std::array<std::unordered_map<int, int>, 3> maps;
@@ -0,0 +1,145 @@
+#ifndef RANK_BITSET_HPP
+#define RANK_BITSET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace legio {
+
+// Fixed-size set of world ranks, stored one bit per rank
+class RankBitset
+{
+   public:
+    RankBitset() = default;
+    explicit RankBitset(const int size) : bits(size), words((size + 63) / 64, 0) {}
+
+    inline void set(const int rank)
+    {
+        words[rank >> 6] |= (uint64_t(1) << (rank & 63));
+        cached_count = -1;
+    }
+
+    inline void reset(const int rank)
+    {
+        words[rank >> 6] &= ~(uint64_t(1) << (rank & 63));
+        cached_count = -1;
+    }
+
+    inline bool test(const int rank) const
+    {
+        return (words[rank >> 6] >> (rank & 63)) & uint64_t(1);
+    }
+
+    inline int size() const { return bits; }
+
+    inline int count() const
+    {
+        if (cached_count < 0)
+        {
+            int total = 0;
+            for (auto word : words)
+                total += __builtin_popcountll(word);
+            cached_count = total;
+        }
+        return cached_count;
+    }
+
+    // True if every rank set in other is also set in this
+    inline bool contains(const RankBitset& other) const
+    {
+        const std::size_t common =
+            words.size() < other.words.size() ? words.size() : other.words.size();
+        for (std::size_t i = 0; i < common; i++)
+            if (other.words[i] & ~words[i])
+                return false;
+        for (std::size_t i = common; i < other.words.size(); i++)
+            if (other.words[i])
+                return false;
+        return true;
+    }
+
+    inline bool operator==(const RankBitset& other) const
+    {
+        return bits == other.bits && words == other.words;
+    }
+
+    inline std::size_t hash() const
+    {
+        std::size_t result = bits;
+        for (auto word : words)
+            result = result * 1099511628211ULL ^ std::hash<uint64_t>()(word);
+        return result;
+    }
+
+   private:
+    int bits = 0;
+    std::vector<uint64_t> words;
+    mutable int cached_count = -1;
+};
+
+struct RankBitsetHash
+{
+    std::size_t operator()(const RankBitset& set) const { return set.hash(); }
+};
+
+// Rank bitset with a Fenwick tree over the set ranks, for logarithmic counting and selection
+class PrefixRankBitset
+{
+   public:
+    PrefixRankBitset() = default;
+    explicit PrefixRankBitset(const int size) : bits(size), tree(size + 1, 0) {}
+
+    inline void set(const int rank)
+    {
+        if (bits.test(rank))
+            return;
+        bits.set(rank);
+        for (int i = rank + 1; i <= size(); i += i & -i)
+            tree[i]++;
+    }
+
+    inline bool test(const int rank) const { return bits.test(rank); }
+
+    inline int size() const { return bits.size(); }
+
+    inline int count() const { return count_before(size()); }
+
+    inline const RankBitset& get_bits() const { return bits; }
+
+    // Number of set ranks in [0, rank)
+    inline int count_before(const int rank) const
+    {
+        int total = 0;
+        for (int i = (rank < size() ? rank : size()); i > 0; i -= i & -i)
+            total += tree[i];
+        return total;
+    }
+
+    // Position of the n-th (starting from 0) unset rank, size() if there is none
+    inline int select_unset(const int n) const
+    {
+        int position = 0, remaining = n + 1, step = 1;
+        while (step * 2 <= size())
+            step *= 2;
+        for (; step > 0; step >>= 1)
+        {
+            int next = position + step;
+            if (next <= size() && step - tree[next] < remaining)
+            {
+                position = next;
+                remaining -= step - tree[next];
+            }
+        }
+        return position;
+    }
+
+   private:
+    RankBitset bits;
+    std::vector<int> tree;
+};
+
+}  // namespace legio
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef REPLICA_MANAGER_HPP
+#define REPLICA_MANAGER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "mpi.h"
+
+namespace legio {
+
+// Active replication of the critical ranks: each of them is shadowed by a replica that runs the
+// same program and receives a copy of every message sent to it on MPI_COMM_WORLD, while its own
+// sends are held back. When the primary fails the replica takes its place in the world; when the
+// replica fails its primary is respawned instead.
+class ReplicaManager
+{
+   public:
+    ReplicaManager(ReplicaManager const&) = delete;
+    ReplicaManager& operator=(ReplicaManager const&) = delete;
+    ReplicaManager() = default;
+
+    // Primaries side, collective over the world: one replica per critical rank known at startup
+    void spawn(int argc, char** argv);
+    // Replica side: receives the shadowed rank from the primaries and waits for promotion
+    void attach();
+
+    inline bool is_replica() const { return replica; }
+    inline bool is_shadowing() const { return shadowing.load(); }
+    // True if a receive on MPI_COMM_WORLD has to be served by receive
+    bool serves(const int source, const int tag);
+
+    // Copy of a message sent to a shadowed rank, delivered to its replica
+    void forward(const void* buf, int count, MPI_Datatype datatype, int dest, int tag);
+    // Messages received from the shadowed ranks, a promoted replica skips the ones already
+    // delivered by its primary
+    void count_received(const int world_rank);
+    // Irecv on MPI_COMM_WORLD, counted once Wait or Test completes it; primaries translate the
+    // source from the link of a shadowing replica, empty for the world itself
+    void track_receive(MPI_Request request, const std::vector<int>& primaries);
+    void complete_receive(MPI_Request request, MPI_Status* status);
+    // A shadowing replica only gets the point-to-point messages of its primary: a collective
+    // on anything but MPI_COMM_SELF would run among the replicas, so the replica is stopped
+    void refuse_collective(MPI_Comm alias, const char* name);
+
+    // While shadowing, sends are held back and receives are served by the primaries
+    void suppress(const void* buf, int count, MPI_Datatype datatype, int dest, int tag);
+    int receive(void* buf,
+                int count,
+                MPI_Datatype datatype,
+                int source,
+                int tag,
+                MPI_Status* status);
+    int ireceive(void* buf,
+                 int count,
+                 MPI_Datatype datatype,
+                 int source,
+                 int tag,
+                 MPI_Request* request);
+
+    // Survivors side: replaces the failed critical ranks with their replicas, false if any of
+    // them has none. Remaining replicas are re-connected to the new world.
+    bool promote(MPI_Comm tmp_world,
+                 const int key,
+                 const std::vector<int>& to_respawn,
+                 const std::vector<int>& failed,
+                 const int world_size,
+                 MPI_Comm* new_world);
+    // After the supported comms are rebuilt: the promoted ranks resend what their primary did not
+    void resume(const std::vector<int>& promoted);
+    // Primaries at finalization, replicas still shadowing are no longer needed
+    void release();
+    // Replica at finalization: waits until released or promoted, true if released
+    bool wait_release();
+
+   private:
+    struct Entry
+    {
+        int tag;
+        std::vector<char> packed;
+    };
+
+    struct Forward
+    {
+        MPI_Request request;
+        std::vector<char> packed;
+        // Index of the destination in shadowed, -1 for the resends of a promoted rank
+        int replica;
+    };
+
+    // Intercomm towards the primaries as seen by a replica, with the world rank of each of them
+    struct Link
+    {
+        MPI_Comm comm;
+        std::vector<int> primaries;
+        // False for the drains, that are never replaced
+        bool current;
+        int remote_of(const int world_rank) const;
+    };
+
+    void listen();
+    void promote_self(const std::vector<int>& message);
+    MPI_Comm reconnect(MPI_Comm merged, MPI_Comm new_comm, const bool in_world);
+    void send_to_replicas(const std::vector<int>& message, MPI_Comm world_comm);
+    void drop_promoted(const std::vector<int>& promoted);
+    void lose_replica(const int index);
+    bool keep_surviving(MPI_Comm shrunk, const std::vector<int>& to_fill);
+    Link pending_link(const int source, const int tag);
+    void complete_forwards();
+    void exit_if_released();
+
+    bool replica = false;
+    // Primaries: intercomm towards the replicas; replicas: towards the primaries
+    MPI_Comm data = MPI_COMM_NULL;
+    // Duplicate of data reserved to promotion and release messages
+    MPI_Comm control = MPI_COMM_NULL;
+    // Replicas: world ranks of the remote group of data
+    std::vector<int> primaries;
+    // Replicas: intercomms replaced by a promotion, still holding forwarded messages
+    std::vector<Link> drains;
+    // World rank shadowed by each replica, indexed by remote rank of data; MPI_UNDEFINED once
+    // the replica failed
+    std::vector<int> shadowed;
+    std::atomic<bool> shadowing{false};
+    std::atomic<bool> released{false};
+    // Received from each shadowed world rank
+    std::map<int, int> received;
+    // Sends held back by a replica, per destination world rank; first is the sequence number of
+    // the oldest entry still kept
+    std::map<int, std::pair<int, std::deque<Entry>>> held_back;
+    std::map<int, std::size_t> held_bytes;
+    // Forwarded and resent copies still in flight
+    std::list<Forward> forwarding;
+    // Irecv requests not completed yet
+    std::map<MPI_Request, std::vector<int>> tracked_receives;
+    std::mutex lock;
+};
+
+}  // namespace legio
+
+#endif
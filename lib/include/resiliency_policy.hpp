@@ -0,0 +1,34 @@
+#ifndef RESILIENCY_POLICY_HPP
+#define RESILIENCY_POLICY_HPP
+
+#include "config.hpp"
+#include "mpi.h"
+
+namespace legio {
+
+// Resiliency behaviour of a comm: the build options, overridden by the info keys named after
+// them with a legio_ prefix (legio_send_resiliency, legio_num_retry, ...); duplicates and splits
+// of a comm inherit its policy
+struct ResiliencyPolicy
+{
+    bool broadcast_resiliency = BuildOptions::broadcast_resiliency;
+    bool send_resiliency = BuildOptions::send_resiliency;
+    int num_retry = BuildOptions::num_retry;
+    bool recv_resiliency = BuildOptions::recv_resiliency;
+    bool reduce_resiliency = BuildOptions::reduce_resiliency;
+    bool get_resiliency = BuildOptions::get_resiliency;
+    bool put_resiliency = BuildOptions::put_resiliency;
+    bool gather_resiliency = BuildOptions::gather_resiliency;
+    bool gather_shift = BuildOptions::gather_shift;
+    bool scatter_resiliency = BuildOptions::scatter_resiliency;
+    bool scatter_shift = BuildOptions::scatter_shift;
+    // legio_unmanaged: the comm is left to the MPI library, without any Legio handling
+    bool unmanaged = false;
+
+    // Keys missing from info leave the current value, booleans accept true/false
+    void update(MPI_Info info);
+};
+
+}  // namespace legio
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef RESILIENT_CALL_HPP
+#define RESILIENT_CALL_HPP
+
+#include "comm_manipulation.hpp"
+#include "complex_comm.hpp"
+#include "config.hpp"
+#include "context.hpp"
+#include "log.hpp"
+#include "mpi.h"
+
+namespace legio {
+
+// What a wrapper does after the call on a comm handled by Legio
+enum class Recovery
+{
+    // Local calls: the outcome is only reported
+    none,
+    // Retried on the replaced comm as soon as it fails locally
+    replace,
+    // The outcome is agreed, retried on the replaced comm if any rank failed
+    agree,
+    // As agree, but with LAZY_AGREEMENT the agreement is left pending
+    collective
+};
+
+// Declarative description of a wrapper: speculative calls honour SPECULATIVE_COLLECTIVES before
+// the recovery, fenced calls first synchronize the alias as the file and window calls do
+template <Recovery R, bool Speculative = false, bool Fenced = false>
+struct CallPolicy
+{
+    static constexpr Recovery recovery = R;
+    static constexpr bool speculative = Speculative;
+    static constexpr bool fenced = Fenced;
+};
+
+using LocalCall = CallPolicy<Recovery::none>;
+using RetriedCall = CallPolicy<Recovery::replace>;
+using AgreedCall = CallPolicy<Recovery::agree>;
+using CollectiveCall = CallPolicy<Recovery::collective>;
+
+namespace detail {
+
+// Access to the comm behind the handle a wrapper receives: a comm or a structure built on one
+inline ComplexComm& complex_of(MPI_Comm comm)
+{
+    return Context::get().m_comm.translate_into_complex(comm);
+}
+
+inline MPI_Comm current_of(ComplexComm& complex, MPI_Comm)
+{
+    return complex.get_comm();
+}
+
+inline MPI_Comm reported_of(MPI_Comm comm)
+{
+    return comm;
+}
+
+template <class MPI_T>
+ComplexComm& complex_of(MPI_T elem)
+{
+    return Context::get().m_comm.get_complex_from_structure(elem);
+}
+
+template <class MPI_T>
+MPI_T current_of(ComplexComm& complex, MPI_T elem)
+{
+    return complex.translate_structure(elem);
+}
+
+template <class MPI_T>
+MPI_Comm reported_of(MPI_T)
+{
+    return MPI_COMM_WORLD;
+}
+
+// Calls on a comm wait for the agreement pending on it, calls on a structure only progress it
+template <class MPI_T>
+constexpr bool waits_agreement = false;
+template <>
+constexpr bool waits_agreement<MPI_Comm> = true;
+
+}  // namespace detail
+
+// Common shape of the wrappers: op performs the PMPI call on the handle it receives, that is the
+// current translation of handle if Legio handles it and handle itself otherwise. The comm behind
+// handle is looked up once per attempt, the replacements happen in place.
+template <class Policy, class MPI_T, class Op>
+inline int resilient_call(const char* name, MPI_T handle, Op&& op)
+{
+    while (1)
+    {
+        int rc;
+        if (!Context::get().m_comm.part_of(handle))
+        {
+            rc = op(handle);
+            legio::report_execution(rc, detail::reported_of(handle), name);
+            return rc;
+        }
+        ComplexComm& translated = detail::complex_of(handle);
+        if constexpr (BuildOptions::replicate_critical && Policy::recovery != Recovery::none)
+            Context::get().rep_manager.refuse_collective(translated.get_alias(), name);
+        if constexpr (Policy::fenced)
+            MPI_Barrier(translated.get_alias());
+        Context::get().m_comm.lock_shared(translated, detail::waits_agreement<MPI_T>);
+        // A replacement after this point is not known to cover the failure of this call
+        const int version = translated.get_version();
+        rc = op(detail::current_of(translated, handle));
+        translated.unlock_shared();
+        legio::report_execution(rc, detail::reported_of(handle), name);
+        if constexpr (Policy::speculative && BuildOptions::speculative_collectives)
+            return agree_lazily(rc, translated, true);
+        if constexpr (Policy::recovery == Recovery::none)
+            return rc;
+        else if constexpr (Policy::recovery == Recovery::replace)
+        {
+            if (rc == MPI_SUCCESS)
+                return rc;
+            replace_comm(translated, version);
+        }
+        else
+        {
+            if constexpr (Policy::recovery == Recovery::collective && BuildOptions::lazy_agreement)
+                return agree_lazily(rc, translated);
+            agree_and_eventually_replace(&rc, translated, version);
+            if (rc == MPI_SUCCESS)
+                return rc;
+        }
+    }
+}
+
+}  // namespace legio
+
+#endif
@@ -1,11 +1,22 @@
 #ifndef RESTART_H
 #define RESTART_H
 
+#include <stddef.h>
 #include "mpi.h"
 
 void initialize_comm(const int n, const int* ranks, MPI_Comm* newcomm);
 int is_respawned();
 void add_critical(int rank);
-// TODO(low-priority) Add callback for restart
+// Buddy checkpointing: regions must be registered in the same order after a respawn, and get
+// back the content of the last commit
+void legio_checkpoint_register(void* buf, size_t size);
+// Allocates and registers a page-aligned region, kept until the process ends; with
+// CHECKPOINT_DIRTY_PAGES only these regions are sent incrementally, until MPI writes into them
+void* legio_checkpoint_alloc(size_t size);
+void legio_checkpoint_commit();
+// Generation of the last commit, or of the restored checkpoint on a respawned rank (0 if none)
+int legio_checkpoint_generation();
+// Bytes sent to the buddy by the last commit
+size_t legio_checkpoint_bytes();
 
 #endif
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <vector>
 #include "complex_comm.hpp"
 #include "mpi.h"
+#include "rank_bitset.hpp"
 #include "supported_comm.hpp"
 
 namespace legio {
@@ -25,10 +26,17 @@ class RestartManager
     int translate_ranks(int, ComplexComm&);
     int untranslate_world_rank(int translated);
 
-    inline std::vector<Rank> get_ranks()
+    // Failure state of the original world ranks
+    inline const PrefixRankBitset& get_failed_ranks() const
     {
         assert(initialized);
-        return ranks;
+        return failed_ranks;
+    }
+
+    inline int get_world_size() const
+    {
+        assert(initialized);
+        return failed_ranks.size();
     }
 
     inline const std::map<int, RespawnedSupportedComm>& access_supported_comms_respawned()
@@ -38,7 +46,7 @@ class RestartManager
         return supported_comms_respawned;
     };
 
-    inline const std::vector<int> get_respawn_list() const
+    inline const std::vector<int>& get_respawn_list() const
     {
         assert(initialized);
         return to_respawn;
@@ -64,12 +72,22 @@ class RestartManager
             return false;
     }
 
+    // Position inside supported_comms_vector of the comm with the given alias, -1 if none
+    inline int get_supported_index(const int alias_id) const
+    {
+        auto found = supported_comms.find(alias_id);
+        return found == supported_comms.end() ? -1 : found->second;
+    }
+
     inline void add_to_supported_comms(std::pair<int, int> addee)
     {
         assert(initialized);
         supported_comms.insert(addee);
     }
 
+    inline MPI_Comm get_spare_pool() const { return spare_pool; }
+    inline void set_spare_pool(MPI_Comm pool) { spare_pool = pool; }
+
     void initialize(const int size);
     void initialize(const int size, const int rank_, const std::vector<int> failed);
     const bool is_initialized();
@@ -78,11 +96,13 @@ class RestartManager
     bool respawned = false;
     bool initialized = false;
     std::mutex init_lock;
-    std::vector<Rank> ranks;
+    PrefixRankBitset failed_ranks;
     std::map<int, RespawnedSupportedComm> supported_comms_respawned;
     int own_rank;
     std::vector<int> to_respawn;
     std::map<int, int> supported_comms;
+    // Intercommunicator towards the idle spares, MPI_COMM_NULL if there are none
+    MPI_Comm spare_pool = MPI_COMM_NULL;
 };
 
 }  // namespace legio
@@ -1,11 +1,56 @@
 #ifndef RESTART_ROUTINES_HPP
 #define RESTART_ROUTINES_HPP
 
+#include <string>
+#include <vector>
+#include "mpi.h"
+
 namespace legio {
 
+// Bootstrap state sent to replacement ranks as a flat integer message:
+// value, world size, ranks to fill, respawn list, failed ranks and the characters of the job key
+// (each list prefixed by its length)
+struct BootstrapState
+{
+    int world_size;
+    std::vector<int> to_fill;
+    std::vector<int> respawn_list;
+    std::vector<int> failed;
+    std::string job_key;
+};
+std::vector<int> encode_bootstrap_message(const int value,
+                                          const std::vector<int>& to_fill,
+                                          const std::vector<int>& failed,
+                                          const int world_size);
+BootstrapState decode_bootstrap_message(const std::vector<int>& message);
+
 void loop_repair_failures();
+// Repair listener thread, stopped before MPI is finalized
+void start_repair_listener();
+void stop_repair_listener();
 void repair_failure();
 void restart(int);
+// Receives rank, failures and respawn list from the survivors that spawned this process
+void receive_respawn_state();
+// Gets back the last checkpoint of a respawned or promoted rank from its buddy
+void restore_checkpoint();
+// Builds a supported comm among the alive world ranks, collective only over them
+MPI_Comm create_supported_comm(const std::vector<int>& alive_world_ranks, const int tag);
+// Rebuilds over the current world the supported comms this rank is part of that contain any of
+// the changed world ranks, the others keep running on their current communicator
+void regenerate_supported_comms(const int rank, const std::vector<int>& changed);
+
+// Spare pool, used instead of respawn when SPARE_POOL_SIZE is set
+void create_spare_pool(int argc, char** argv);
+void release_spare_pool();
+bool repair_from_spare_pool(MPI_Comm tmp_world,
+                            const int key,
+                            const std::vector<int>& to_respawn,
+                            const std::vector<int>& failed,
+                            const int world_size,
+                            MPI_Comm* new_world);
+// Parks a spare until it replaces a failed rank, returns the new world
+MPI_Comm wait_for_promotion();
 
 }  // namespace legio
 
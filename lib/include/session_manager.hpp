@@ -1,13 +1,24 @@
 #ifndef SESSION_MANAGER_HPP
 #define SESSION_MANAGER_HPP
 
+#include <future>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <unordered_map>
 #include <vector>
 #include "mpi.h"
+#include "rank_bitset.hpp"
 
 namespace legio {
 
+struct Horizon
+{
+    MPI_Comm comm;
+    // Members of the horizon, indexed by rank in the world group
+    RankBitset members;
+};
+
 class SessionManager
 {
    public:
@@ -17,25 +28,39 @@ class SessionManager
     SessionManager& operator=(SessionManager&&) = default;
     SessionManager() = default;
     MPI_Comm get_horizon_comm(MPI_Group);
+    // Builds the horizon over the world group in background, waited only when first needed
+    void start_horizon_construction();
 
     void add_horizon_comm(MPI_Comm);
+    MPI_Group get_world_group() { return world_group; }
 
     void add_pending_session(MPI_Session session);
     void add_open_session();
     void close_session();
-    void initialize();
+    void initialize(MPI_Group);
     const bool is_initialized();
 
    private:
+    RankBitset to_bitset(MPI_Group);
+    // Returns false if the background construction did not complete within HORIZON_TIMEOUT,
+    // with join it waits for it anyway
+    bool wait_horizon_construction(const bool join);
+
     std::mutex horizon_lock;
     std::mutex session_lock;
     std::mutex init_lock;
+    std::mutex construction_lock;
+    std::shared_future<MPI_Comm> construction;
     std::vector<MPI_Session> pending;
-    std::list<MPI_Comm> horizon_comms;
+    // Horizons not contained in one another, sorted by increasing size
+    std::list<Horizon> horizon_comms;
+    // Smallest horizon covering each group already looked up, reset when the horizons change
+    std::unordered_map<RankBitset, MPI_Comm, RankBitsetHash> horizon_index;
+    MPI_Group world_group = MPI_GROUP_NULL;
     int open_sessions = 0;
     bool initialized = false;
 };
 
 }  // namespace legio
 
-#endif
\ No newline at end of file
+#endif
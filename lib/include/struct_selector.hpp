@@ -1,6 +1,7 @@
 #ifndef STRUCT_SELECTOR_HPP
 #define STRUCT_SELECTOR_HPP
 
+#include <memory>
 #include <tuple>
 #include "config.hpp"
 #include "mpi.h"
@@ -43,9 +44,10 @@ inline const int c2f<MPI_Session>(const MPI_Session session)
 }
 #endif
 
-typedef std::tuple<StructureHandler<MPI_Win, MPI_Comm>*,
-                   StructureHandler<MPI_File, MPI_Comm>*,
-                   StructureHandler<MPI_Request, MPI_Comm>*>
+// Shared by the copies of a ComplexComm, released with the last of them
+typedef std::tuple<std::shared_ptr<StructureHandler<MPI_Win, MPI_Comm>>,
+                   std::shared_ptr<StructureHandler<MPI_File, MPI_Comm>>,
+                   std::shared_ptr<StructureHandler<MPI_Request, MPI_Comm>>>
     handlers;
 
 template <class MPI_T>
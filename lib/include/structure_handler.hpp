@@ -17,6 +17,7 @@ class StructureHandler
                      std::function<int(T*)>,
                      std::function<int(T, T*)>,
                      int);
+    virtual ~StructureHandler() = default;
     void add_general(T, std::function<int(U, T*)>);
     void add(int, T, std::function<int(U, T*)>);
     T translate(T);
@@ -3,48 +3,38 @@
 
 #include <vector>
 #include "mpi.h"
+#include "rank_bitset.hpp"
 
 namespace legio {
 
-class Rank
-{
-   public:
-    Rank(int number, bool failed);
-    bool failed;
-    // The rank based on MPI_COMM_WORLD
-    int number;
-};
-
 class SupportedComm
 {
    public:
-    SupportedComm(MPI_Comm comm, std::vector<Rank> world_ranks);
-    int get_failed_ranks_before(int rank);
-    MPI_Comm get_alias() { return alias; };
-
-    std::vector<Rank> get_current_world_ranks() { return world_ranks; }
-    void set_failed(int world_rank)
+    SupportedComm(MPI_Comm comm, std::vector<int> world_ranks);
+    inline int get_failed_ranks_before(const int rank) const
     {
-        for (auto& rank : world_ranks)
-            if (rank.number == world_rank)
-            {
-                rank.failed = true;
-                break;
-            }
+        return failed.count_before(rank);
     }
+    MPI_Comm get_alias() const { return alias; };
+
+    inline const std::vector<int>& get_world_ranks() const { return world_ranks; }
+    inline bool is_failed(const int position) const { return failed.test(position); }
+    void set_failed(int world_rank);
 
     MPI_Comm alias;
     // Ordered vector with the world ranks
-    std::vector<Rank> world_ranks;
+    std::vector<int> world_ranks;
+    // Failed ranks, indexed by their position inside world_ranks
+    PrefixRankBitset failed;
 };
 
 class RespawnedSupportedComm : public SupportedComm
 {
    public:
-    int size();
-    int rank();
+    int size() const;
+    int rank() const;
 };
 
 }  // namespace legio
 
-#endif
\ No newline at end of file
+#endif
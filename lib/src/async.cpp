@@ -3,7 +3,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <shared_mutex>
 #include "comm_manipulation.hpp"
 #include "complex_comm.hpp"
 #include "config.hpp"
@@ -11,7 +10,6 @@
 #include "log.hpp"
 #include "mpi-ext.h"
 
-extern std::shared_timed_mutex failure_mtx;
 using namespace legio;
 
 int MPI_Isend(const void* buf,
@@ -23,6 +21,13 @@ int MPI_Isend(const void* buf,
               MPI_Request* request)
 {
     int rc;
+    if constexpr (BuildOptions::replicate_critical)
+        if (comm == MPI_COMM_WORLD && Context::get().rep_manager.is_shadowing())
+        {
+            Context::get().rep_manager.suppress(buf, count, datatype, dest, tag);
+            *request = MPI_REQUEST_NULL;
+            return MPI_SUCCESS;
+        }
 
     int size;
     int flag = Context::get().m_comm.part_of(comm);
@@ -30,7 +35,7 @@ int MPI_Isend(const void* buf,
     void* tempbuf = malloc(size * count);
     memcpy(tempbuf, buf, size * count);
     std::function<int(MPI_Comm, MPI_Request*)> func;
-    failure_mtx.lock_shared();
+    Context::get().m_comm.lock_shared(comm);
     if (flag)
     {
         ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
@@ -38,7 +43,7 @@ int MPI_Isend(const void* buf,
         dest_rank = translate_ranks(dest, translated);
         if (dest_rank == MPI_UNDEFINED)
         {
-            if constexpr (BuildOptions::send_resiliency)
+            if (translated.get_policy().send_resiliency)
                 rc = MPI_SUCCESS;
             else
             {
@@ -60,12 +65,17 @@ int MPI_Isend(const void* buf,
                 else
                     return PMPI_Isend(tempbuf, count, datatype, new_rank, tag, actual, request);
             };
+            if constexpr (BuildOptions::message_logging)
+                Context::get().m_log.record(buf, count, datatype, dest, tag, translated);
+            if constexpr (BuildOptions::replicate_critical)
+                if (comm == MPI_COMM_WORLD)
+                    Context::get().rep_manager.forward(buf, count, datatype, dest, tag);
             rc = PMPI_Isend(buf, count, datatype, dest_rank, tag, translated.get_comm(), request);
         }
     }
     else
         rc = PMPI_Isend(buf, count, datatype, dest, tag, comm, request);
-    failure_mtx.unlock_shared();
+    Context::get().m_comm.unlock_shared(comm);
     legio::report_execution(rc, comm, "Isend");
     if (!flag)
         return rc;
@@ -84,17 +94,21 @@ int MPI_Irecv(void* buf,
               MPI_Comm comm,
               MPI_Request* request)
 {
+    Context::get().c_manager.expose(buf);
     int rc;
+    if constexpr (BuildOptions::replicate_critical)
+        if (comm == MPI_COMM_WORLD && Context::get().rep_manager.serves(source, tag))
+            return Context::get().rep_manager.ireceive(buf, count, datatype, source, tag, request);
     bool flag = Context::get().m_comm.part_of(comm);
     std::function<int(MPI_Comm, MPI_Request*)> func;
-    failure_mtx.lock_shared();
+    Context::get().m_comm.lock_shared(comm);
     if (flag)
     {
         ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
         int source_rank = translate_ranks(source, translated);
         if (source_rank == MPI_UNDEFINED)
         {
-            if constexpr (BuildOptions::recv_resiliency)
+            if (translated.get_policy().recv_resiliency)
                 rc = MPI_SUCCESS;
             else
             {
@@ -121,8 +135,11 @@ int MPI_Irecv(void* buf,
     }
     else
         rc = PMPI_Irecv(buf, count, datatype, source, tag, comm, request);
-    failure_mtx.unlock_shared();
+    Context::get().m_comm.unlock_shared(comm);
     legio::report_execution(rc, comm, "Irecv");
+    if constexpr (BuildOptions::replicate_critical)
+        if (comm == MPI_COMM_WORLD && rc == MPI_SUCCESS)
+            Context::get().rep_manager.track_receive(*request, {});
     if (!flag)
         return rc;
     else if (rc == MPI_SUCCESS)
@@ -135,8 +152,13 @@ int MPI_Wait(MPI_Request* request, MPI_Status* status)
 {
     int rc;
     MPI_Request old = *request;
+    MPI_Status own_status;
+    // The source of a tracked receive is needed to count it
+    if constexpr (BuildOptions::replicate_critical)
+        if (status == MPI_STATUS_IGNORE)
+            status = &own_status;
     bool flag = Context::get().m_comm.part_of(*request);
-    failure_mtx.lock_shared();
+    Context::get().m_comm.lock_shared(*request);
     if (flag)
     {
         ComplexComm& comm = Context::get().m_comm.get_complex_from_structure(*request);
@@ -146,8 +168,11 @@ int MPI_Wait(MPI_Request* request, MPI_Status* status)
     else
         rc = PMPI_Wait(request, status);
 
-    failure_mtx.unlock_shared();
+    Context::get().m_comm.unlock_shared(*request);
     legio::report_execution(rc, MPI_COMM_WORLD, "Wait");
+    if constexpr (BuildOptions::replicate_critical)
+        if (rc == MPI_SUCCESS)
+            Context::get().rep_manager.complete_receive(old, status);
 
     Context::get().m_comm.remove_structure(request);
     return rc;
@@ -156,8 +181,13 @@ int MPI_Wait(MPI_Request* request, MPI_Status* status)
 int MPI_Test(MPI_Request* request, int* flag, MPI_Status* status)
 {
     int rc;
+    MPI_Request old = *request;
+    MPI_Status own_status;
+    if constexpr (BuildOptions::replicate_critical)
+        if (status == MPI_STATUS_IGNORE)
+            status = &own_status;
     bool part = Context::get().m_comm.part_of(*request);
-    failure_mtx.lock_shared();
+    Context::get().m_comm.lock_shared(*request);
     if (part)
     {
         ComplexComm& comm = Context::get().m_comm.get_complex_from_structure(*request);
@@ -166,10 +196,13 @@ int MPI_Test(MPI_Request* request, int* flag, MPI_Status* status)
     }
     else
         rc = PMPI_Test(request, flag, status);
-    failure_mtx.unlock_shared();
+    Context::get().m_comm.unlock_shared(*request);
     legio::report_execution(rc, MPI_COMM_WORLD, "Test");
     if (*flag)
     {
+        if constexpr (BuildOptions::replicate_critical)
+            if (rc == MPI_SUCCESS)
+                Context::get().rep_manager.complete_receive(old, status);
         Context::get().m_comm.remove_structure(request);
     }
     return rc;
@@ -0,0 +1,657 @@
+#include "checkpoint_manager.hpp"
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <string>
+#include <vector>
+#include "complex_comm.hpp"
+#include "context.hpp"
+#include "log.hpp"
+#include "mpi.h"
+extern "C" {
+#include "legio.h"
+}
+
+using namespace legio;
+
+namespace {
+
+const std::size_t page_size = sysconf(_SC_PAGESIZE);
+struct sigaction previous_action;
+
+// Pages of a region allocated by Legio. The fault handler only reads this table: an entry is
+// filled before the count publishes it and never changes afterwards, apart from its flags
+struct TrackedRegion
+{
+    char* first_page;
+    std::size_t pages;
+    std::atomic<unsigned char>* dirty;
+    // Written by MPI, so always sent in full
+    std::atomic<bool> exposed;
+};
+
+constexpr int max_tracked_regions = 64;
+TrackedRegion tracked_regions[max_tracked_regions];
+std::atomic<int> tracked_count(0);
+
+int find_tracked(const char* address)
+{
+    const int count = tracked_count.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++)
+        if (address >= tracked_regions[i].first_page &&
+            address < tracked_regions[i].first_page + tracked_regions[i].pages * page_size)
+            return i;
+    return -1;
+}
+
+// Only touches the table, the flags and mprotect, so it is safe on any thread
+void dirty_page_handler(int signal, siginfo_t* info, void* context)
+{
+    const char* address = static_cast<const char*>(info->si_addr);
+    const int index = find_tracked(address);
+    if (index >= 0)
+    {
+        TrackedRegion& region = tracked_regions[index];
+        const std::size_t page = (address - region.first_page) / page_size;
+        region.dirty[page].store(1, std::memory_order_relaxed);
+        mprotect(region.first_page + page * page_size, page_size, PROT_READ | PROT_WRITE);
+        return;
+    }
+    // Not a tracked page: restore the previous handler and let the access fault again
+    sigaction(SIGSEGV, &previous_action, NULL);
+}
+
+// Tracked regions are mapped by Legio and never lie on a stack, so no alternate stack is needed
+void install_dirty_page_handler()
+{
+    static bool installed = false;
+    if (installed)
+        return;
+    installed = true;
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = dirty_page_handler;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, &previous_action);
+}
+
+void append_chunk(std::vector<std::size_t>& chunks,
+                  const std::size_t offset,
+                  const std::size_t length)
+{
+    if (!chunks.empty() && chunks[chunks.size() - 2] + chunks.back() == offset)
+        chunks.back() += length;
+    else
+    {
+        chunks.push_back(offset);
+        chunks.push_back(length);
+    }
+}
+
+}  // namespace
+
+int CheckpointManager::own_world_rank()
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    return rank;
+}
+
+// Next world rank, in ring order, that is not permanently failed
+int CheckpointManager::buddy_of(const int world_rank)
+{
+    const PrefixRankBitset& failed = Context::get().r_manager.get_failed_ranks();
+    int candidate = world_rank;
+    do
+        candidate = (candidate + 1) % failed.size();
+    while (failed.test(candidate) && candidate != world_rank);
+    return candidate;
+}
+
+// Previous world rank, in ring order, that is not permanently failed
+int CheckpointManager::ward_of(const int world_rank)
+{
+    const PrefixRankBitset& failed = Context::get().r_manager.get_failed_ranks();
+    int candidate = world_rank;
+    do
+        candidate = (candidate + failed.size() - 1) % failed.size();
+    while (failed.test(candidate) && candidate != world_rank);
+    return candidate;
+}
+
+void CheckpointManager::register_region(void* buf, const std::size_t size)
+{
+    add_region(buf, size, -1);
+}
+
+void* CheckpointManager::allocate_region(const std::size_t size)
+{
+    const std::size_t pages = std::max<std::size_t>((size + page_size - 1) / page_size, 1);
+    void* buf = mmap(NULL, pages * page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1, 0);
+    if (buf == MAP_FAILED)
+        return nullptr;
+    int index = -1;
+    if constexpr (BuildOptions::checkpoint_dirty_pages)
+    {
+        index = tracked_count.load(std::memory_order_relaxed);
+        if (index < max_tracked_regions)
+        {
+            TrackedRegion& region = tracked_regions[index];
+            region.first_page = static_cast<char*>(buf);
+            region.pages = pages;
+            region.dirty = new std::atomic<unsigned char>[pages]();
+            region.exposed.store(false);
+            tracked_count.store(index + 1, std::memory_order_release);
+            install_dirty_page_handler();
+        }
+        else
+        {
+            legio::log("Too many checkpoint regions, pages not tracked", LogLevel::errors_only);
+            index = -1;
+        }
+    }
+    add_region(buf, size, index);
+    return buf;
+}
+
+void CheckpointManager::add_region(void* buf, const std::size_t size, const int tracked)
+{
+    Region region;
+    region.buf = static_cast<char*>(buf);
+    region.size = size;
+    region.image_offset = image_size;
+    region.tracked = tracked;
+    image_size += size;
+    // The buddy has no base for the new region
+    force_full = true;
+
+    if (restored_offset + size <= restored.size())
+    {
+        memcpy(buf, restored.data() + restored_offset, size);
+        restored_offset += size;
+    }
+    regions.push_back(region);
+}
+
+void CheckpointManager::untrack(const void* buf)
+{
+    const int index = find_tracked(static_cast<const char*>(buf));
+    if (index < 0 || tracked_regions[index].exposed.exchange(true))
+        return;
+    mprotect(tracked_regions[index].first_page, tracked_regions[index].pages * page_size,
+             PROT_READ | PROT_WRITE);
+}
+
+// Write-protects the tracked regions so that the first write to each page is recorded
+void CheckpointManager::protect_regions()
+{
+    for (const auto& region : regions)
+    {
+        if (region.tracked < 0)
+            continue;
+        TrackedRegion& pages = tracked_regions[region.tracked];
+        if (pages.exposed.load())
+            continue;
+        for (std::size_t page = 0; page < pages.pages; page++)
+            pages.dirty[page].store(0, std::memory_order_relaxed);
+        mprotect(pages.first_page, pages.pages * page_size, PROT_READ);
+    }
+}
+
+void CheckpointManager::wait_pending()
+{
+    const std::lock_guard<std::mutex> guard(pending_lock);
+    if (pending.valid())
+        pending.get();
+}
+
+bool CheckpointManager::is_pending()
+{
+    const std::lock_guard<std::mutex> guard(pending_lock);
+    return pending.valid();
+}
+
+void CheckpointManager::commit()
+{
+    wait_pending();
+    generation++;
+
+    const int own = own_world_rank();
+    const int buddy = buddy_of(own);
+    const int ward = ward_of(own);
+    const bool full = !BuildOptions::checkpoint_dirty_pages || force_full || buddy != last_buddy;
+
+    std::vector<std::size_t> chunks;
+    for (const auto& region : regions)
+    {
+        if (full || region.tracked < 0 || tracked_regions[region.tracked].exposed.load())
+        {
+            append_chunk(chunks, region.image_offset, region.size);
+            continue;
+        }
+        // Tracked regions start on a page boundary
+        const TrackedRegion& pages = tracked_regions[region.tracked];
+        for (std::size_t page = 0; page < pages.pages; page++)
+        {
+            const std::size_t low = page * page_size;
+            if (pages.dirty[page].load(std::memory_order_relaxed) && low < region.size)
+                append_chunk(chunks, region.image_offset + low,
+                             std::min(page_size, region.size - low));
+        }
+    }
+
+    Header header = {generation, full, image_size, chunks.size() / 2};
+    std::size_t total = sizeof(Header) + chunks.size() * sizeof(std::size_t);
+    for (std::size_t i = 1; i < chunks.size(); i += 2)
+        total += chunks[i];
+    staging.resize(total);
+    memcpy(staging.data(), &header, sizeof(Header));
+    memcpy(staging.data() + sizeof(Header), chunks.data(), chunks.size() * sizeof(std::size_t));
+    char* data = staging.data() + sizeof(Header) + chunks.size() * sizeof(std::size_t);
+    auto region = regions.begin();
+    for (std::size_t i = 0; i < chunks.size(); i += 2)
+    {
+        // Chunks are sorted by offset and never cross regions, apart from merged neighbours
+        std::size_t offset = chunks[i], remaining = chunks[i + 1];
+        while (remaining > 0)
+        {
+            while (offset >= region->image_offset + region->size)
+                region++;
+            std::size_t length =
+                std::min(remaining, region->image_offset + region->size - offset);
+            memcpy(data, region->buf + (offset - region->image_offset), length);
+            data += length;
+            offset += length;
+            remaining -= length;
+        }
+    }
+    last_bytes = staging.size();
+    if constexpr (BuildOptions::checkpoint_path[0] != '\0' || BuildOptions::checkpoint_shm)
+    {
+        char* image = own_image_data();
+        // A crash while patching leaves the segment without a valid generation
+        if (shared_state != nullptr)
+            shared_state->generation = 0;
+        patch(image, staging);
+        if (shared_state != nullptr)
+            shared_state->generation = generation;
+        if constexpr (BuildOptions::checkpoint_path[0] != '\0')
+            start_flush();
+    }
+    last_buddy = buddy;
+    force_full = false;
+    if constexpr (BuildOptions::checkpoint_dirty_pages)
+        protect_regions();
+
+    if (buddy == own)
+        return;
+    // The world is not replaced while the transfer starts on it, a repair joins the transfer
+    // before replacing it
+    Context::get().m_comm.lock_shared(MPI_COMM_WORLD);
+    ComplexComm& world = Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD);
+    const int buddy_rank = Context::get().r_manager.translate_ranks(buddy, world);
+    const int ward_rank = Context::get().r_manager.translate_ranks(ward, world);
+    {
+        const std::lock_guard<std::mutex> guard(pending_lock);
+        pending = std::async(std::launch::async, &CheckpointManager::transfer, this,
+                             world.get_comm(), buddy_rank, ward_rank, ward);
+    }
+    Context::get().m_comm.unlock_shared(MPI_COMM_WORLD);
+}
+
+void CheckpointManager::transfer(MPI_Comm comm,
+                                 const int buddy,
+                                 const int ward,
+                                 const int ward_world_rank)
+{
+    MPI_Request request;
+    MPI_Status status;
+    int count;
+    PMPI_Isend(staging.data(), staging.size(), MPI_BYTE, buddy, LEGIO_CHECKPOINT_TAG, comm,
+               &request);
+    // The held copy is updated only once the whole message is received
+    if (PMPI_Probe(ward, LEGIO_CHECKPOINT_TAG, comm, &status) == MPI_SUCCESS)
+    {
+        PMPI_Get_count(&status, MPI_BYTE, &count);
+        std::vector<char> incoming(count);
+        if (PMPI_Recv(incoming.data(), count, MPI_BYTE, ward, LEGIO_CHECKPOINT_TAG, comm,
+                      MPI_STATUS_IGNORE) == MPI_SUCCESS)
+            apply(incoming, ward_world_rank);
+    }
+    else
+        legio::log("Checkpoint of the ward not received", LogLevel::errors_only);
+    if (PMPI_Wait(&request, MPI_STATUS_IGNORE) != MPI_SUCCESS)
+        legio::log("Checkpoint not delivered to the buddy", LogLevel::errors_only);
+}
+
+// Copies the chunks of a commit message inside the image
+void CheckpointManager::patch(char* image, const std::vector<char>& message)
+{
+    Header header;
+    memcpy(&header, message.data(), sizeof(Header));
+    const std::size_t* chunks =
+        reinterpret_cast<const std::size_t*>(message.data() + sizeof(Header));
+    const char* data = message.data() + sizeof(Header) + 2 * header.chunks * sizeof(std::size_t);
+    for (std::size_t i = 0; i < header.chunks; i++)
+    {
+        memcpy(image + chunks[2 * i], data, chunks[2 * i + 1]);
+        data += chunks[2 * i + 1];
+    }
+}
+
+void CheckpointManager::apply(const std::vector<char>& message, const int ward_world_rank)
+{
+    Header header;
+    memcpy(&header, message.data(), sizeof(Header));
+    if (header.full)
+        held.assign(sizeof(int) + header.total, 0);
+    else if (held_rank != ward_world_rank || held.size() != sizeof(int) + header.total)
+    {
+        legio::log("Incremental checkpoint without a base, dropped", LogLevel::errors_only);
+        held.clear();
+        held_rank = -1;
+        return;
+    }
+    patch(held.data() + sizeof(int), message);
+    memcpy(held.data(), &header.generation, sizeof(int));
+    held_rank = ward_world_rank;
+}
+
+void CheckpointManager::restore(const std::vector<int>& respawned)
+{
+    wait_pending();
+    force_full = true;
+    const int own = own_world_rank();
+    const bool restarting =
+        std::find(respawned.begin(), respawned.end(), own) != respawned.end();
+    ComplexComm& world = Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD);
+    const int buddy = buddy_of(own);
+    const int none = 0;
+
+    // A rank respawned on the same node finds its last commit in shared memory, and asks the
+    // buddy only for a newer one
+    MPI_Request request = MPI_REQUEST_NULL;
+    if (restarting)
+    {
+        if constexpr (BuildOptions::checkpoint_shm)
+            map_shared_state(false);
+        if (buddy != own)
+            PMPI_Isend(&generation, 1, MPI_INT,
+                       Context::get().r_manager.translate_ranks(buddy, world),
+                       LEGIO_CHECKPOINT_REQUEST_TAG, world.get_comm(), &request);
+    }
+
+    // A respawned rank that found no segment may have left one on its former node: the ranks
+    // there remove it before the new incarnation creates its own, after this restore
+    if constexpr (BuildOptions::checkpoint_shm)
+    {
+        std::vector<int> found(respawned.size(), 0);
+        for (std::size_t i = 0; i < respawned.size(); i++)
+            if (respawned[i] == own)
+                found[i] = shared_state != nullptr;
+        PMPI_Allreduce(MPI_IN_PLACE, found.data(), found.size(), MPI_INT, MPI_MAX,
+                       world.get_comm());
+        for (std::size_t i = 0; i < respawned.size(); i++)
+            if (!found[i] && respawned[i] != own)
+                shm_unlink(shared_state_name(respawned[i]).c_str());
+    }
+
+    // Every buddy answers, with an empty checkpoint if it holds nothing newer for that rank
+    std::vector<MPI_Request> requests;
+    for (auto rank : respawned)
+    {
+        if (rank == own || buddy_of(rank) != own)
+            continue;
+        int known, held_generation = 0;
+        const int ward_rank = Context::get().r_manager.translate_ranks(rank, world);
+        PMPI_Recv(&known, 1, MPI_INT, ward_rank, LEGIO_CHECKPOINT_REQUEST_TAG, world.get_comm(),
+                  MPI_STATUS_IGNORE);
+        if (!restarting && held_rank == rank && !held.empty())
+            memcpy(&held_generation, held.data(), sizeof(int));
+        const bool sending = held_generation > known;
+        requests.emplace_back();
+        PMPI_Isend(sending ? held.data() : reinterpret_cast<const char*>(&none),
+                   sending ? held.size() : sizeof(int), MPI_BYTE, ward_rank,
+                   LEGIO_CHECKPOINT_TAG, world.get_comm(), &requests.back());
+    }
+
+    if (restarting && buddy != own)
+    {
+        MPI_Status status;
+        int count, received;
+        const int buddy_rank = Context::get().r_manager.translate_ranks(buddy, world);
+        PMPI_Probe(buddy_rank, LEGIO_CHECKPOINT_TAG, world.get_comm(), &status);
+        PMPI_Get_count(&status, MPI_BYTE, &count);
+        std::vector<char> incoming(count);
+        PMPI_Recv(incoming.data(), count, MPI_BYTE, buddy_rank, LEGIO_CHECKPOINT_TAG,
+                  world.get_comm(), MPI_STATUS_IGNORE);
+        memcpy(&received, incoming.data(), sizeof(int));
+        if (received > generation)
+        {
+            generation = received;
+            restored.swap(incoming);
+            restored_offset = sizeof(int);
+        }
+    }
+    // The copies in memory are preferred, the disk is used only if it holds a newer generation
+    if constexpr (BuildOptions::checkpoint_path[0] != '\0')
+        if (restarting)
+            read_from_disk();
+    PMPI_Wait(&request, MPI_STATUS_IGNORE);
+    PMPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+
+    // Every rank learns where the respawned ones resume from, for the message log replay
+    std::vector<int> generations(respawned.size(), 0);
+    for (std::size_t i = 0; i < respawned.size(); i++)
+        if (respawned[i] == own)
+            generations[i] = generation;
+    PMPI_Allreduce(MPI_IN_PLACE, generations.data(), generations.size(), MPI_INT, MPI_MAX,
+                   world.get_comm());
+    restored_generations.clear();
+    for (std::size_t i = 0; i < respawned.size(); i++)
+        restored_generations[respawned[i]] = generations[i];
+}
+
+int CheckpointManager::get_restored_generation(const int world_rank) const
+{
+    auto found = restored_generations.find(world_rank);
+    return found == restored_generations.end() ? 0 : found->second;
+}
+
+std::string CheckpointManager::file_name(const int slot)
+{
+    return std::string(BuildOptions::checkpoint_path) + "/legio_checkpoint_" +
+           std::to_string(own_world_rank()) + "_" + std::to_string(slot);
+}
+
+// Hands the last commit to the I/O task, skipped if the previous flush is still running
+void CheckpointManager::start_flush()
+{
+    if (flushing.valid())
+    {
+        if (flushing.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            legio::log("Checkpoint flush still running, generation not written",
+                       LogLevel::full);
+            return;
+        }
+        flushing.get();
+    }
+    char* image = own_image_data();
+    flush_buffer.assign(image, image + image_size);
+    flush_generation = generation;
+    flushing = std::async(std::launch::async, &CheckpointManager::flush, this);
+}
+
+void CheckpointManager::flush()
+{
+    MPI_File& file = slots[flush_generation % 2];
+    if (file == MPI_FILE_NULL &&
+        MPI_File_open(MPI_COMM_SELF, file_name(flush_generation % 2).c_str(),
+                      MPI_MODE_CREATE | MPI_MODE_RDWR, MPI_INFO_NULL, &file) != MPI_SUCCESS)
+    {
+        legio::log("Unable to open the checkpoint file", LogLevel::errors_only);
+        file = MPI_FILE_NULL;
+        return;
+    }
+    // Invalidate the slot, write the image and only then stamp its generation
+    FileHeader header = {0, flush_buffer.size()};
+    MPI_File_write_at(file, 0, &header, sizeof(FileHeader), MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_sync(file);
+    MPI_File_write_at(file, sizeof(FileHeader), flush_buffer.data(), flush_buffer.size(),
+                      MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_sync(file);
+    header.generation = flush_generation;
+    MPI_File_write_at(file, 0, &header, sizeof(FileHeader), MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_sync(file);
+}
+
+void CheckpointManager::read_from_disk()
+{
+    for (int slot = 0; slot < 2; slot++)
+    {
+        MPI_File file;
+        FileHeader header;
+        if (MPI_File_open(MPI_COMM_SELF, file_name(slot).c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL,
+                          &file) != MPI_SUCCESS)
+            continue;
+        if (MPI_File_read_at(file, 0, &header, sizeof(FileHeader), MPI_BYTE,
+                             MPI_STATUS_IGNORE) == MPI_SUCCESS &&
+            header.generation > generation)
+        {
+            std::vector<char> image(sizeof(int) + header.size);
+            if (MPI_File_read_at(file, sizeof(FileHeader), image.data() + sizeof(int),
+                                 header.size, MPI_BYTE, MPI_STATUS_IGNORE) == MPI_SUCCESS)
+            {
+                memcpy(image.data(), &header.generation, sizeof(int));
+                generation = header.generation;
+                restored.swap(image);
+                restored_offset = sizeof(int);
+            }
+        }
+        MPI_File_close(&file);
+    }
+}
+
+void CheckpointManager::close()
+{
+    wait_pending();
+    if (flushing.valid())
+        flushing.get();
+    for (auto& file : slots)
+        if (file != MPI_FILE_NULL)
+            MPI_File_close(&file);
+}
+
+std::string CheckpointManager::launcher_job_key()
+{
+    std::string key;
+    for (const char* variable : {"PMIX_NAMESPACE", "OMPI_MCA_ess_base_jobid", "SLURM_JOB_ID"})
+        if (const char* value = getenv(variable))
+        {
+            key = value;
+            break;
+        }
+    if (key.empty())
+    {
+        char host[256] = "";
+        gethostname(host, sizeof(host) - 1);
+        key = std::string(host) + "_" + std::to_string(getpid());
+    }
+    // Segment names take no slashes
+    std::replace_if(key.begin(), key.end(), [](char c) { return !isalnum(c) && c != '-'; }, '_');
+    return key;
+}
+
+std::string CheckpointManager::shared_state_name(const int world_rank) const
+{
+    return "/legio_" + job_key + "_" + std::to_string(world_rank);
+}
+
+// Storage of the own image, (re)mapping the shared memory segment when the image grows
+char* CheckpointManager::own_image_data()
+{
+    if constexpr (BuildOptions::checkpoint_shm)
+        if (!shared_state_disabled)
+        {
+            if (shared_state_size != sizeof(FileHeader) + image_size)
+                map_shared_state(true);
+            if (shared_state != nullptr)
+                return reinterpret_cast<char*>(shared_state + 1);
+            legio::log("Shared memory state unavailable, using private memory",
+                       LogLevel::errors_only);
+            shared_state_disabled = true;
+            shm_unlink(shared_state_path.c_str());
+            // Rebuilt from the regions, that already hold the state being committed
+            own_image.resize(image_size);
+            for (const auto& region : regions)
+                memcpy(own_image.data() + region.image_offset, region.buf, region.size);
+        }
+    own_image.resize(image_size);
+    return own_image.data();
+}
+
+// Maps the segment of this rank; without create, an existing segment left by the previous
+// incarnation is attached and its last commit restored
+void CheckpointManager::map_shared_state(const bool create)
+{
+    if (shared_state != nullptr)
+        munmap(shared_state, shared_state_size);
+    shared_state = nullptr;
+    shared_state_size = 0;
+
+    shared_state_path = shared_state_name(own_world_rank());
+    int fd = shm_open(shared_state_path.c_str(), O_RDWR | (create ? O_CREAT : 0), 0600);
+    if (fd < 0)
+        return;
+    struct stat info;
+    std::size_t size = sizeof(FileHeader) + image_size;
+    if (!create && fstat(fd, &info) == 0)
+        size = info.st_size;
+    if (size < sizeof(FileHeader) || (create && ftruncate(fd, size) != 0))
+    {
+        ::close(fd);
+        return;
+    }
+    void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        return;
+    shared_state = static_cast<FileHeader*>(mapping);
+    shared_state_size = size;
+    if (create)
+        shared_state->size = image_size;
+
+    if (!create && shared_state->generation > generation &&
+        shared_state->size + sizeof(FileHeader) <= size)
+    {
+        const char* image = reinterpret_cast<const char*>(shared_state + 1);
+        generation = shared_state->generation;
+        restored.resize(sizeof(int) + shared_state->size);
+        memcpy(restored.data(), &generation, sizeof(int));
+        memcpy(restored.data() + sizeof(int), image, shared_state->size);
+        restored_offset = sizeof(int);
+    }
+}
+
+void CheckpointManager::release_shared_state()
+{
+    if (shared_state == nullptr)
+        return;
+    munmap(shared_state, shared_state_size);
+    shared_state = nullptr;
+    shared_state_size = 0;
+    shm_unlink(shared_state_path.c_str());
+}
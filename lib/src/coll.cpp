@@ -1,63 +1,73 @@
 #include <mpi.h>
 #include <signal.h>
 #include <stdio.h>
-#include <shared_mutex>
 #include "comm_manipulation.hpp"
 #include "complex_comm.hpp"
 #include "context.hpp"
 #include "log.hpp"
 #include "mpi-ext.h"
+#include "resilient_call.hpp"
 
-extern std::shared_timed_mutex failure_mtx;
 using namespace legio;
 
+// Agreed like the other collectives, left pending as a speculative collective if enabled
+using SpeculativeCollective = CallPolicy<Recovery::collective, true>;
+
 int MPI_Barrier(MPI_Comm comm)
 {
-    int rank;
-    MPI_Comm_rank(comm, &rank);
+    // An agreement left pending is no barrier, so then the barrier runs before it
+    if constexpr (BuildOptions::speculative_collectives || BuildOptions::lazy_agreement)
+        return resilient_call<SpeculativeCollective>(
+            "Barrier", comm, [](MPI_Comm c) { return PMPI_Barrier(c); });
+    if constexpr (BuildOptions::replicate_critical)
+        Context::get().rep_manager.refuse_collective(comm, "Barrier");
     while (1)
     {
-        int rc;
-        int rank, size;
+        int rc, version = 0;
         bool flag = Context::get().m_comm.part_of(comm);
-        failure_mtx.lock_shared();
+        Context::get().m_comm.lock_shared(comm);
         if (flag)
         {
+            // The agreement already waits for every alive rank, so it is the whole barrier. Its
+            // return code depends on the failures each rank acknowledged, only the flag is the
+            // same on all of them: it tells whether any rank knows of a failure in the comm
             ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
-            rc = PMPI_Barrier(translated.get_comm());
+            version = translated.get_version();
+            MPIX_Comm_failure_ack(translated.get_comm());
+            int agreed = acked_failures(translated.get_comm()).empty();
+            MPIX_Comm_agree(translated.get_comm(), &agreed);
+            rc = agreed ? MPI_SUCCESS : MPIX_ERR_PROC_FAILED;
         }
         else
-        {
             rc = PMPI_Barrier(comm);
-        }
-        failure_mtx.unlock_shared();
+        Context::get().m_comm.unlock_shared(comm);
 
         legio::report_execution(rc, comm, "Barrier");
-        if (flag)
-        {
-            agree_and_eventually_replace(&rc, Context::get().m_comm.translate_into_complex(comm));
-            if (rc == MPI_SUCCESS)
-                return rc;
-        }
-        else
+        if (rc == MPI_SUCCESS || !flag)
             return rc;
+        else
+            replace_comm(Context::get().m_comm.translate_into_complex(comm), version);
     }
 }
 
 int MPI_Bcast(void* buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm)
 {
+    Context::get().c_manager.expose(buffer);
+    if constexpr (BuildOptions::replicate_critical)
+        Context::get().rep_manager.refuse_collective(comm, "Bcast");
     while (1)
     {
-        int rc;
+        int rc, version = 0;
         bool flag = Context::get().m_comm.part_of(comm);
-        failure_mtx.lock_shared();
+        Context::get().m_comm.lock_shared(comm);
         if (flag)
         {
             ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
+            version = translated.get_version();
             int root_rank = translate_ranks(root, translated);
             if (root_rank == MPI_UNDEFINED)
             {
-                if constexpr (BuildOptions::broadcast_resiliency)
+                if (translated.get_policy().broadcast_resiliency)
                     rc = MPI_SUCCESS;
                 else
                 {
@@ -70,11 +80,16 @@ int MPI_Bcast(void* buffer, int count, MPI_Datatype datatype, int root, MPI_Comm
         }
         else
             rc = PMPI_Bcast(buffer, count, datatype, root, comm);
-        failure_mtx.unlock_shared();
+        Context::get().m_comm.unlock_shared(comm);
         legio::report_execution(rc, comm, "Bcast");
         if (flag)
         {
-            agree_and_eventually_replace(&rc, Context::get().m_comm.translate_into_complex(comm));
+            if constexpr (BuildOptions::speculative_collectives)
+                return agree_lazily(rc, Context::get().m_comm.translate_into_complex(comm), true);
+            if constexpr (BuildOptions::lazy_agreement)
+                return agree_lazily(rc, Context::get().m_comm.translate_into_complex(comm));
+            agree_and_eventually_replace(&rc, Context::get().m_comm.translate_into_complex(comm),
+                                         version);
             if (rc == MPI_SUCCESS)
                 return rc;
         }
@@ -90,25 +105,10 @@ int MPI_Allreduce(const void* sendbuf,
                   MPI_Op op,
                   MPI_Comm comm)
 {
-    while (1)
-    {
-        int rc;
-        bool flag = Context::get().m_comm.part_of(comm);
-        failure_mtx.lock_shared();
-        if (flag)
-        {
-            ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
-            rc = PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, translated.get_comm());
-        }
-        else
-            rc = PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm);
-        failure_mtx.unlock_shared();
-        legio::report_execution(rc, comm, "Allreduce");
-        if (rc == MPI_SUCCESS || !flag)
-            return rc;
-        else
-            replace_comm(Context::get().m_comm.translate_into_complex(comm));
-    }
+    Context::get().c_manager.expose(recvbuf);
+    return resilient_call<SpeculativeCollective>("Allreduce", comm, [&](MPI_Comm c) {
+        return PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, c);
+    });
 }
 
 int MPI_Reduce(const void* sendbuf,
@@ -119,18 +119,22 @@ int MPI_Reduce(const void* sendbuf,
                int root,
                MPI_Comm comm)
 {
+    Context::get().c_manager.expose(recvbuf);
+    if constexpr (BuildOptions::replicate_critical)
+        Context::get().rep_manager.refuse_collective(comm, "Reduce");
     while (1)
     {
-        int rc;
+        int rc, version = 0;
         bool flag = Context::get().m_comm.part_of(comm);
-        failure_mtx.lock_shared();
+        Context::get().m_comm.lock_shared(comm);
         if (flag)
         {
             ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
+            version = translated.get_version();
             int root_rank = translate_ranks(root, translated);
             if (root_rank == MPI_UNDEFINED)
             {
-                if constexpr (BuildOptions::reduce_resiliency)
+                if (translated.get_policy().reduce_resiliency)
                     rc = MPI_SUCCESS;
                 else
                 {
@@ -144,11 +148,14 @@ int MPI_Reduce(const void* sendbuf,
         }
         else
             rc = PMPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm);
-        failure_mtx.unlock_shared();
+        Context::get().m_comm.unlock_shared(comm);
         legio::report_execution(rc, comm, "Reduce");
         if (flag)
         {
-            agree_and_eventually_replace(&rc, Context::get().m_comm.translate_into_complex(comm));
+            if constexpr (BuildOptions::lazy_agreement)
+                return agree_lazily(rc, Context::get().m_comm.translate_into_complex(comm));
+            agree_and_eventually_replace(&rc, Context::get().m_comm.translate_into_complex(comm),
+                                         version);
             if (rc == MPI_SUCCESS)
                 return rc;
         }
@@ -167,26 +174,34 @@ int perform_gather(const void* sendbuf,
                    MPI_Comm comm,
                    int totalsize,
                    int fakerank,
-                   MPI_Comm fakecomm)
+                   const bool shift)
 {
-    if constexpr (BuildOptions::gather_shift)
+    if (shift)
         return PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
     else
     {
-        int type_size, cur_rank;
+        // The caller holds the lock on comm and recovers a failure through its agreement, so the
+        // window lives on comm itself and is never handled by Legio
+        int rc, type_size, cur_rank;
         MPI_Win win;
         MPI_Type_size(recvtype, &type_size);
         MPI_Comm_rank(comm, &cur_rank);
         if (cur_rank == root)
-            MPI_Win_create(recvbuf, totalsize * recvcount * type_size, type_size, MPI_INFO_NULL,
-                           fakecomm, &win);
+            rc = PMPI_Win_create(recvbuf, totalsize * recvcount * type_size, type_size,
+                                 MPI_INFO_NULL, comm, &win);
         else
-            MPI_Win_create(recvbuf, 0, type_size, MPI_INFO_NULL, fakecomm, &win);
-        MPI_Win_fence(0, win);
-        MPI_Put(sendbuf, sendcount, sendtype, root, fakerank * recvcount, recvcount, recvtype, win);
-        MPI_Win_fence(0, win);
-        MPI_Win_free(&win);
-        return MPI_SUCCESS;
+            rc = PMPI_Win_create(recvbuf, 0, type_size, MPI_INFO_NULL, comm, &win);
+        if (rc != MPI_SUCCESS)
+            return rc;
+        PMPI_Win_set_errhandler(win, MPI_ERRORS_RETURN);
+        rc = PMPI_Win_fence(0, win);
+        if (rc == MPI_SUCCESS)
+            rc = PMPI_Put(sendbuf, sendcount, sendtype, root, fakerank * recvcount, recvcount,
+                          recvtype, win);
+        if (rc == MPI_SUCCESS)
+            rc = PMPI_Win_fence(0, win);
+        PMPI_Win_free(&win);
+        return rc;
     }
 }
 
@@ -199,21 +214,27 @@ int MPI_Gather(const void* sendbuf,
                int root,
                MPI_Comm comm)
 {
+    Context::get().c_manager.expose(recvbuf);
+    if constexpr (BuildOptions::replicate_critical)
+        Context::get().rep_manager.refuse_collective(comm, "Gather");
     while (1)
     {
-        int rc, actual_root, total_size, fake_rank;
+        int rc, actual_root, total_size, fake_rank, version = 0;
         bool flag = Context::get().m_comm.part_of(comm);
         MPI_Comm actual_comm;
         MPI_Comm_size(comm, &total_size);
         MPI_Comm_rank(comm, &fake_rank);
         if (flag)
         {
+            // A pending agreement may replace the comm, so it is read under the lock
+            Context::get().m_comm.lock_shared(comm);
             ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
+            version = translated.get_version();
             actual_comm = translated.get_comm();
             actual_root = translate_ranks(root, translated);
             if (actual_root == MPI_UNDEFINED)
             {
-                if constexpr (BuildOptions::gather_resiliency)
+                if (translated.get_policy().gather_resiliency)
                     rc = MPI_SUCCESS;
                 else
                 {
@@ -222,27 +243,29 @@ int MPI_Gather(const void* sendbuf,
                 }
             }
             else
-            {
-                failure_mtx.lock_shared();
                 rc = perform_gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
-                                    actual_root, actual_comm, total_size, fake_rank, comm);
-                failure_mtx.unlock_shared();
-            }
+                                    actual_root, actual_comm, total_size, fake_rank,
+                                    translated.get_policy().gather_shift);
+            Context::get().m_comm.unlock_shared(comm);
         }
         else
         {
             actual_comm = comm;
             actual_root = root;
-            failure_mtx.lock_shared();
+            Context::get().m_comm.lock_shared(comm);
             rc = perform_gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
-                                actual_root, actual_comm, total_size, fake_rank, comm);
-            failure_mtx.unlock_shared();
+                                actual_root, actual_comm, total_size, fake_rank,
+                                BuildOptions::gather_shift);
+            Context::get().m_comm.unlock_shared(comm);
         }
 
         legio::report_execution(rc, comm, "Gather");
         if (flag)
         {
-            agree_and_eventually_replace(&rc, Context::get().m_comm.translate_into_complex(comm));
+            if constexpr (BuildOptions::lazy_agreement)
+                return agree_lazily(rc, Context::get().m_comm.translate_into_complex(comm));
+            agree_and_eventually_replace(&rc, Context::get().m_comm.translate_into_complex(comm),
+                                         version);
             if (rc == MPI_SUCCESS)
                 return rc;
         }
@@ -261,26 +284,33 @@ int perform_scatter(const void* sendbuf,
                     MPI_Comm comm,
                     int totalsize,
                     int fakerank,
-                    MPI_Comm fakecomm)
+                    const bool shift)
 {
-    if constexpr (BuildOptions::scatter_shift)
+    if (shift)
         return PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
     else
     {
-        int type_size, cur_rank;
+        // As in perform_gather, the window is on the comm locked by the caller
+        int rc, type_size, cur_rank;
         MPI_Win win;
         MPI_Type_size(recvtype, &type_size);
         MPI_Comm_rank(comm, &cur_rank);
         if (cur_rank == root)
-            MPI_Win_create((void*)sendbuf, totalsize * sendcount * type_size, type_size,
-                           MPI_INFO_NULL, fakecomm, &win);
+            rc = PMPI_Win_create((void*)sendbuf, totalsize * sendcount * type_size, type_size,
+                                 MPI_INFO_NULL, comm, &win);
         else
-            MPI_Win_create((void*)sendbuf, 0, type_size, MPI_INFO_NULL, fakecomm, &win);
-        MPI_Win_fence(0, win);
-        MPI_Get(recvbuf, recvcount, recvtype, root, fakerank * sendcount, sendcount, sendtype, win);
-        MPI_Win_fence(0, win);
-        MPI_Win_free(&win);
-        return MPI_SUCCESS;
+            rc = PMPI_Win_create((void*)sendbuf, 0, type_size, MPI_INFO_NULL, comm, &win);
+        if (rc != MPI_SUCCESS)
+            return rc;
+        PMPI_Win_set_errhandler(win, MPI_ERRORS_RETURN);
+        rc = PMPI_Win_fence(0, win);
+        if (rc == MPI_SUCCESS)
+            rc = PMPI_Get(recvbuf, recvcount, recvtype, root, fakerank * sendcount, sendcount,
+                          sendtype, win);
+        if (rc == MPI_SUCCESS)
+            rc = PMPI_Win_fence(0, win);
+        PMPI_Win_free(&win);
+        return rc;
     }
 }
 
@@ -293,21 +323,27 @@ int MPI_Scatter(const void* sendbuf,
                 int root,
                 MPI_Comm comm)
 {
+    Context::get().c_manager.expose(recvbuf);
+    if constexpr (BuildOptions::replicate_critical)
+        Context::get().rep_manager.refuse_collective(comm, "Scatter");
     while (1)
     {
-        int rc, actual_root, total_size, fake_rank;
+        int rc, actual_root, total_size, fake_rank, version = 0;
         bool flag = Context::get().m_comm.part_of(comm);
         MPI_Comm actual_comm;
         MPI_Comm_size(comm, &total_size);
         MPI_Comm_rank(comm, &fake_rank);
         if (flag)
         {
+            // A pending agreement may replace the comm, so it is read under the lock
+            Context::get().m_comm.lock_shared(comm);
             ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
+            version = translated.get_version();
             actual_comm = translated.get_comm();
             actual_root = translate_ranks(root, translated);
             if (actual_root == MPI_UNDEFINED)
             {
-                if constexpr (BuildOptions::scatter_resiliency)
+                if (translated.get_policy().scatter_resiliency)
                     rc = MPI_SUCCESS;
                 else
                 {
@@ -316,27 +352,29 @@ int MPI_Scatter(const void* sendbuf,
                 }
             }
             else
-            {
-                failure_mtx.lock_shared();
                 rc = perform_scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
-                                     actual_root, actual_comm, total_size, fake_rank, comm);
-                failure_mtx.unlock_shared();
-            }
+                                     actual_root, actual_comm, total_size, fake_rank,
+                                     translated.get_policy().scatter_shift);
+            Context::get().m_comm.unlock_shared(comm);
         }
         else
         {
             actual_comm = comm;
             actual_root = root;
-            failure_mtx.lock_shared();
+            Context::get().m_comm.lock_shared(comm);
             rc = perform_scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype,
-                                 actual_root, actual_comm, total_size, fake_rank, comm);
-            failure_mtx.unlock_shared();
+                                 actual_root, actual_comm, total_size, fake_rank,
+                                 BuildOptions::scatter_shift);
+            Context::get().m_comm.unlock_shared(comm);
         }
 
         legio::report_execution(rc, comm, "Scatter");
         if (flag)
         {
-            agree_and_eventually_replace(&rc, Context::get().m_comm.translate_into_complex(comm));
+            if constexpr (BuildOptions::lazy_agreement)
+                return agree_lazily(rc, Context::get().m_comm.translate_into_complex(comm));
+            agree_and_eventually_replace(&rc, Context::get().m_comm.translate_into_complex(comm),
+                                         version);
             if (rc == MPI_SUCCESS)
                 return rc;
         }
@@ -352,27 +390,8 @@ int MPI_Scan(const void* sendbuf,
              MPI_Op op,
              MPI_Comm comm)
 {
-    while (1)
-    {
-        int rc;
-        bool flag = Context::get().m_comm.part_of(comm);
-        failure_mtx.lock_shared();
-        if (flag)
-        {
-            ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
-            rc = PMPI_Scan(sendbuf, recvbuf, count, datatype, op, translated.get_comm());
-        }
-        else
-            rc = PMPI_Scan(sendbuf, recvbuf, count, datatype, op, comm);
-        failure_mtx.unlock_shared();
-        legio::report_execution(rc, comm, "Scan");
-        if (flag)
-        {
-            agree_and_eventually_replace(&rc, Context::get().m_comm.translate_into_complex(comm));
-            if (rc == MPI_SUCCESS)
-                return rc;
-        }
-        else
-            return rc;
-    }
+    Context::get().c_manager.expose(recvbuf);
+    return resilient_call<CollectiveCall>("Scan", comm, [&](MPI_Comm c) {
+        return PMPI_Scan(sendbuf, recvbuf, count, datatype, op, c);
+    });
 }
\ No newline at end of file
@@ -1,8 +1,11 @@
 #include "comm_manipulation.hpp"
+#include <algorithm>
+#include <chrono>
 #include <numeric>
-#include <shared_mutex>
+#include <mutex>
 #include <sstream>
 #include <thread>
+#include <unistd.h>
 #include "complex_comm.hpp"
 #include "context.hpp"
 #include "log.hpp"
@@ -15,7 +18,6 @@ extern "C" {
 
 #include "mpi-ext.h"
 
-extern std::shared_timed_mutex failure_mtx;
 using namespace legio;
 
 // Far capire al processo respawnato il communicatore
@@ -30,69 +32,88 @@ void legio::initialization(int* argc, char*** argv)
 {
     MPI_Comm_set_errhandler(MPI_COMM_WORLD, MPI_ERRORS_RETURN);
     MPI_Comm_set_errhandler(MPI_COMM_SELF, MPI_ERRORS_RETURN);
-    int size, rank;
-    std::vector<int> failed;
+    int size;
 
     if constexpr (BuildOptions::with_restart)
     {
-        if (command_line_option_exists(argc, argv, "--respawned"))
+        if (command_line_option_exists(argc, argv, "--spare"))
         {
-            size = std::stoi(get_command_line_option(argc, argv, "--size"));
-            char* possibly_null_failed = get_command_line_option(argc, argv, "--failed-ranks");
-            if (possibly_null_failed != 0)
+            // Idle until a critical rank fails, then take its place in the world
+            MPI_Comm new_world = wait_for_promotion();
+            Context::get().m_comm.add_comm(MPI_COMM_SELF);
+            Context::get().m_comm.add_comm(MPI_COMM_WORLD);
+            MPI_Comm_set_errhandler(new_world, MPI_ERRORS_RETURN);
+            Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD).replace_comm(new_world);
+            restore_checkpoint();
+            return;
+        }
+        if constexpr (BuildOptions::replicate_critical)
+            if (command_line_option_exists(argc, argv, "--replica"))
             {
-                std::string raw_failed = possibly_null_failed;
-                std::stringstream ss(raw_failed);
-                while (ss.good())
-                {
-                    std::string substr;
-                    getline(ss, substr, ',');
-                    // cur_comms->set_failed_rank(std::stoi(substr));
-                    failed.push_back(std::stoi(substr));
-                }
+                // Runs alongside its primary until promoted, its world is served by the primaries
+                Context::get().rep_manager.attach();
+                Context::get().m_comm.add_comm(MPI_COMM_SELF);
+                Context::get().m_comm.add_comm(MPI_COMM_WORLD);
+                return;
             }
-
-            rank = std::stoi(get_command_line_option(argc, argv, "--rank"));
-            // printf("PARSED RANK: %d\n", rank);
-            // cur_comms = new RespawnMulticomm(size, rank, failed);
-            Context::get().r_manager.initialize(size, rank, failed);
-        }
+        if (command_line_option_exists(argc, argv, "--respawned"))
+            receive_respawn_state();
         else
         {
             PMPI_Comm_size(MPI_COMM_WORLD, &size);
             Context::get().r_manager.initialize(size);
-        }
+            if constexpr (BuildOptions::checkpoint_shm)
+            {
+                // The job id of the launcher tells apart the shared memory segments of different
+                // jobs, the one seen by rank 0 is used by all
+                std::string job_key = CheckpointManager::launcher_job_key();
+                int length = job_key.size();
+                PMPI_Bcast(&length, 1, MPI_INT, 0, MPI_COMM_WORLD);
+                job_key.resize(length);
+                PMPI_Bcast(job_key.data(), length, MPI_CHAR, 0, MPI_COMM_WORLD);
+                Context::get().c_manager.set_job_key(job_key);
+            }
 
-        char* possibly_null_to_respawn = get_command_line_option(argc, argv, "--to-respawn");
-        if (possibly_null_to_respawn != 0)
-        {
-            std::string raw_to_respawn = possibly_null_to_respawn;
-            std::stringstream ss(raw_to_respawn);
-            while (ss.good())
+            // Critical ranks given at launch, respawned ranks receive them from the survivors
+            char* possibly_null_to_respawn = get_command_line_option(argc, argv, "--to-respawn");
+            if (possibly_null_to_respawn != 0)
             {
-                std::string substr;
+                std::string raw_to_respawn = possibly_null_to_respawn;
+                std::stringstream ss(raw_to_respawn);
+                while (ss.good())
+                {
+                    std::string substr;
 
-                getline(ss, substr, ',');
-                legio::log(substr.c_str(), LogLevel::full);
-                Context::get().r_manager.add_to_respawn_list(std::stoi(substr));
+                    getline(ss, substr, ',');
+                    legio::log(substr.c_str(), LogLevel::full);
+                    Context::get().r_manager.add_to_respawn_list(std::stoi(substr));
+                }
             }
         }
     }
     else
     {
 #if WITH_SESSION
-        MPI_Comm temp;
         MPI_Session temp_session;
         MPI_Group temp_group;
-        PMPI_Session_init(MPI_INFO_NULL, MPI_ERRORS_RETURN, &temp_session);
+        if constexpr (BuildOptions::session_thread)
+        {
+            MPI_Info tinfo;
+            PMPI_Info_create(&tinfo);
+            PMPI_Info_set(tinfo, "mpi_thread_support_level", "MPI_THREAD_MULTIPLE");
+            PMPI_Session_init(tinfo, MPI_ERRORS_RETURN, &temp_session);
+            PMPI_Info_free(&tinfo);
+        }
+        else
+            PMPI_Session_init(MPI_INFO_NULL, MPI_ERRORS_RETURN, &temp_session);
         PMPI_Group_from_session_pset(temp_session, "mpi://WORLD", &temp_group);
-        PMPI_Comm_create_from_group(temp_group, "Legio_horizon_construction", MPI_INFO_NULL,
-                                    MPI_ERRORS_RETURN, &temp);
-        PMPI_Group_free(&temp_group);
         Context::get().s_manager.add_pending_session(temp_session);
         Context::get().s_manager.add_open_session();
-        Context::get().s_manager.initialize();
-        Context::get().s_manager.add_horizon_comm(temp);
+        Context::get().s_manager.initialize(temp_group);
+        // The world-wide creation is kept out of MPI_Init: it runs in background when a thread
+        // is allowed, otherwise horizons come from the first creates, as with MPI_Session_init
+        if constexpr (BuildOptions::session_thread)
+            Context::get().s_manager.start_horizon_construction();
 #endif
     }
 
@@ -111,18 +132,25 @@ void legio::initialization(int* argc, char*** argv)
 
 void legio::finalization()
 {
+    if constexpr (BuildOptions::with_restart)
+        Context::get().c_manager.release_shared_state();
 #if WITH_SESSION
     Context::get().s_manager.close_session();
 #endif
 }
 
-void legio::replace_comm(ComplexComm& cur_complex)
+void legio::replace_comm(ComplexComm& cur_complex, const int version)
 {
     if constexpr (BuildOptions::with_restart)
         if (!Context::get().r_manager.get_respawn_list().empty())
             return replace_and_repair_comm(cur_complex);
+    // A replacement done by another thread since the failed call covers the same failure
+    const std::lock_guard<ComplexComm> guard(cur_complex);
+    if (cur_complex.get_version() != version)
+        return;
     MPI_Comm new_comm;
     int old_size, new_size, diff;
+    settle_failures(cur_complex.get_comm());
     MPIX_Comm_shrink(cur_complex.get_comm(), &new_comm);
     MPI_Comm_size(cur_complex.get_comm(), &old_size);
     MPI_Comm_size(new_comm, &new_size);
@@ -138,75 +166,137 @@ void legio::replace_comm(ComplexComm& cur_complex)
 
 void legio::replace_and_repair_comm(ComplexComm& cur_complex)
 {
-    MPI_Comm new_comm, world;
-    MPI_Group group;
-    int old_size, new_size, failed, ranks[LEGIO_MAX_FAILS], i, rank, current_rank;
-    std::set<int> failed_ranks_set;
-
     ComplexComm& world_complex = Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD);
+    int revoked = 0;
     MPIX_Comm_failure_ack(world_complex.get_comm());
-    who_failed(world_complex.get_comm(), &failed, ranks);
+    MPIX_Comm_is_revoked(world_complex.get_comm(), &revoked);
+    if (!revoked && acked_failures(world_complex.get_comm()).empty())
+        return;
 
-    if (failed != 0)
-    {
-        // if (VERBOSE)
-        // {
-        //     int rank, size;
-        //     MPI_Comm_size(MPI_COMM_WORLD, &size);
-        //     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-        //     printf("[is_respawned: %d] Detected failure in rank %d / %d.\n", is_respawned(),
-        //     rank,
-        //            size);
-        // }
-        for (i = 0; i < failed; i++)
-        {
-            failed_ranks_set.insert(ranks[i]);
-        }
-        MPI_Group world_group, not_failed_group, cur_group, to_be_notified_group;
-        MPI_Comm not_failed_comm;
-        int buf = LEGIO_FAILURE_PING_VALUE, notify_size, cur_rank;
-        std::vector<int> not_failed_group_ranks, new_group_ranks;
-
-        // Communicate to all not failed ranks that they must start restart procedure
-        PMPI_Comm_group(world_complex.get_comm(), &world_group);
-        PMPI_Comm_group(cur_complex.get_comm(), &cur_group);
-        PMPI_Group_excl(world_group, failed, ranks, &not_failed_group);
-        PMPI_Group_difference(not_failed_group, cur_group, &to_be_notified_group);
-        PMPI_Group_size(to_be_notified_group, &notify_size);
-        PMPI_Comm_rank(world_complex.get_comm(), &cur_rank);
-        if (notify_size > 0)
-        {
-            MPI_Request* requests = (MPI_Request*)malloc(sizeof(MPI_Request) * notify_size);
-            MPI_Status* statuses = (MPI_Status*)malloc(sizeof(MPI_Status) * notify_size);
-            for (int i = 0; i < notify_size; i++)
-            {
-                int target_rank;
-                MPI_Group_translate_ranks(to_be_notified_group, 1, &i, world_group, &target_rank);
-                PMPI_Issend(&buf, 1, MPI_INT, target_rank, LEGIO_FAILURE_TAG,
-                            world_complex.get_comm(), &(requests[i]));
-            }
-            MPI_Waitall(notify_size, requests, statuses);
-            free(requests);
-            free(statuses);
-        }
+    // Revoking the world notifies every survivor through the fault-tolerant propagation of the
+    // MPI library, ranks outside cur_complex get it through their repair listener. Detectors of
+    // the same failure revoke it only once.
+    if (!revoked)
+        MPIX_Comm_revoke(world_complex.get_comm());
 
-        // PMPI_Group_size(not_failed_group, &not_failed_size);
-        // PMPI_Comm_create_group(world_complex->get_comm(), not_failed_group, 1, &not_failed_comm);
-        // PMPI_Comm_rank(not_failed_comm, &current_rank);
-        failure_mtx.lock();
-        repair_failure();
-        failure_mtx.unlock();
-    }
+    repair_failure();
 }
 
-void legio::agree_and_eventually_replace(int* rc, ComplexComm& cur_complex)
+void legio::agree_and_eventually_replace(int* rc, ComplexComm& cur_complex, const int version)
 {
     int flag = (MPI_SUCCESS == *rc);
     MPIX_Comm_agree(cur_complex.get_comm(), &flag);
     if (!flag && *rc == MPI_SUCCESS)
         *rc = MPIX_ERR_PROC_FAILED;
     if (*rc != MPI_SUCCESS)
-        replace_comm(cur_complex);
+        replace_comm(cur_complex, version);
+}
+
+void legio::release_comm(MPI_Comm comm)
+{
+    if (comm == MPI_COMM_WORLD)
+    {
+        legio::log("MPI_COMM_WORLD is always handled by Legio, legio_unmanaged ignored",
+                   LogLevel::errors_only);
+        Context::get().m_comm.translate_into_complex(comm).get_policy().unmanaged = false;
+        return;
+    }
+    // Failures already repaired by Legio are still part of the user handle
+    Context::get().m_comm.remove(comm, [](MPI_Comm* internal) { return PMPI_Comm_free(internal); });
+}
+
+// Set by MPIX_Rollback_handler_set
+static void (*rollback_handler)(MPI_Comm, int) = nullptr;
+
+void legio::set_rollback_handler(void (*handler)(MPI_Comm, int))
+{
+    rollback_handler = handler;
+}
+
+int legio::agree_lazily(const int rc, ComplexComm& cur_complex, const bool speculative)
+{
+    complete_agreement(cur_complex, true);
+    cur_complex.start_agreement(rc == MPI_SUCCESS, speculative);
+    // The other ranks find the failure when completing the agreement at their next call
+    if (rc != MPI_SUCCESS)
+        complete_agreement(cur_complex, true);
+    return rc;
+}
+
+void legio::complete_agreement(ComplexComm& cur_complex, const bool wait)
+{
+    int flag, epoch, version;
+    if (!cur_complex.finish_agreement(wait, &flag, &epoch, &version) || flag)
+        return;
+    legio::log("Failure found by a pending agreement, replacing the comm",
+               LogLevel::errors_and_info);
+    replace_comm(cur_complex, version);
+    // No lock is held here, the handler can already use the repaired comm
+    if (epoch != 0 && rollback_handler != nullptr)
+        rollback_handler(cur_complex.get_alias(), epoch);
+}
+
+// Ranks of comm that belong to group
+static std::vector<int> ranks_in_comm(MPI_Group group, MPI_Comm comm)
+{
+    MPI_Group comm_group;
+    int size;
+    PMPI_Group_size(group, &size);
+    PMPI_Comm_group(comm, &comm_group);
+    std::vector<int> positions(size), ranks(size);
+    std::iota(positions.begin(), positions.end(), 0);
+    PMPI_Group_translate_ranks(group, size, positions.data(), comm_group, ranks.data());
+    PMPI_Group_free(&comm_group);
+    return ranks;
+}
+
+std::vector<int> legio::acked_failures(MPI_Comm comm)
+{
+    MPI_Group failed;
+    MPIX_Comm_failure_get_acked(comm, &failed);
+    std::vector<int> ranks = ranks_in_comm(failed, comm);
+    PMPI_Group_free(&failed);
+    return ranks;
+}
+
+void legio::settle_failures(MPI_Comm comm)
+{
+    if constexpr (BuildOptions::failure_settle_window > 0)
+    {
+        using clock = std::chrono::steady_clock;
+        const auto window = std::chrono::milliseconds(BuildOptions::failure_settle_window);
+        const auto slice = std::max(window / 8, std::chrono::milliseconds(1));
+        // Bounded, a steady stream of failures must not stop the recovery forever
+        const auto deadline = clock::now() + 8 * window;
+        int known, current;
+        MPIX_Comm_failure_ack(comm);
+        fault_number(comm, &known);
+        auto quiet_since = clock::now();
+        while (clock::now() - quiet_since < window && clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(slice);
+            MPIX_Comm_failure_ack(comm);
+            fault_number(comm, &current);
+            if (current != known)
+            {
+                known = current;
+                quiet_since = clock::now();
+            }
+        }
+    }
+}
+
+std::vector<int> legio::excluded_ranks(MPI_Comm comm, MPI_Comm shrunk)
+{
+    MPI_Group comm_group, shrunk_group, excluded;
+    PMPI_Comm_group(comm, &comm_group);
+    PMPI_Comm_group(shrunk, &shrunk_group);
+    PMPI_Group_difference(comm_group, shrunk_group, &excluded);
+    std::vector<int> ranks = ranks_in_comm(excluded, comm);
+    PMPI_Group_free(&excluded);
+    PMPI_Group_free(&shrunk_group);
+    PMPI_Group_free(&comm_group);
+    return ranks;
 }
 
 int legio::translate_ranks(const int rank, ComplexComm& comm)
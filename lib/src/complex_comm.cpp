@@ -1,5 +1,7 @@
 #include "complex_comm.hpp"
 #include <mutex>
+#include "log.hpp"
+#include "mpi-ext.h"
 #include "mpi.h"
 #include "request_handler.hpp"
 #include "restart.h"
@@ -8,7 +10,13 @@
 extern std::mutex change_world_mtx;
 using namespace legio;
 
-ComplexComm::ComplexComm(MPI_Comm comm, int id) : cur_comm(comm), alias_id(id)
+ComplexComm::ComplexComm(MPI_Comm comm, int id)
+    : cur_comm(comm),
+      alias_id(id),
+      checked_groups(std::make_shared<GroupCache>()),
+      comm_mtx(std::make_shared<std::shared_timed_mutex>()),
+      version(std::make_shared<std::atomic<int>>(0)),
+      agreement(std::make_shared<PendingAgreement>())
 {
     std::function<int(MPI_Win, int*)> setter_w = [](MPI_Win w, int* value) -> int {
         return MPI_SUCCESS;
@@ -28,7 +36,8 @@ ComplexComm::ComplexComm(MPI_Comm comm, int id) : cur_comm(comm), alias_id(id)
     };
 
     std::get<handle_selector<MPI_Win>::get()>(struct_handlers) =
-        new StructureHandler<MPI_Win, MPI_Comm>(setter_w, getter_w, killer_w, adapter_w, 0);
+        std::make_shared<StructureHandler<MPI_Win, MPI_Comm>>(setter_w, getter_w, killer_w,
+                                                              adapter_w, 0);
 
     std::function<int(MPI_File, int*)> setter_f = [](MPI_File f, int* value) -> int {
         return MPI_SUCCESS;
@@ -57,7 +66,8 @@ ComplexComm::ComplexComm(MPI_Comm comm, int id) : cur_comm(comm), alias_id(id)
     };
 
     std::get<handle_selector<MPI_File>::get()>(struct_handlers) =
-        new StructureHandler<MPI_File, MPI_Comm>(setter_f, getter_f, killer_f, adapter_f, 1);
+        std::make_shared<StructureHandler<MPI_File, MPI_Comm>>(setter_f, getter_f, killer_f,
+                                                               adapter_f, 1);
 
     std::function<int(MPI_Request, int*)> setter_r = [](MPI_Request r, int* value) -> int {
         return MPI_SUCCESS;
@@ -80,9 +90,18 @@ ComplexComm::ComplexComm(MPI_Comm comm, int id) : cur_comm(comm), alias_id(id)
         [](MPI_Request old, MPI_Request* updated) -> int { return MPI_SUCCESS; };
 
     std::get<handle_selector<MPI_Request>::get()>(struct_handlers) =
-        new RequestHandler(setter_r, getter_r, killer_r, adapter_r, 1);
-
-    MPI_Comm_group(comm, &group);
+        std::make_shared<RequestHandler>(setter_r, getter_r, killer_r, adapter_r, 1);
+
+    MPI_Group comm_group;
+    MPI_Comm_group(comm, &comm_group);
+    group = std::shared_ptr<MPI_Group>(new MPI_Group(comm_group), [](MPI_Group* g) {
+        // Comms still registered at exit are released after MPI is finalized
+        int finalized;
+        PMPI_Finalized(&finalized);
+        if (!finalized)
+            PMPI_Group_free(g);
+        delete g;
+    });
 }
 
 MPI_Comm ComplexComm::get_comm()
@@ -106,17 +125,60 @@ void ComplexComm::replace_comm(MPI_Comm comm)
     PMPI_Comm_get_info(cur_comm, &info);
     PMPI_Comm_set_info(comm, info);
     PMPI_Info_free(&info);
-    PMPI_Comm_free(&cur_comm);
+    // The first working comm may be the user handle itself, left to the user to free
+    if (cur_comm != get_alias())
+        PMPI_Comm_free(&cur_comm);
     cur_comm = comm;
+    advance_failure_epoch();
+    (*version)++;
     if (get_alias() == MPI_COMM_WORLD)
     {
         change_world_mtx.unlock();
     }
 }
 
+void ComplexComm::start_agreement(const int flag, const bool speculative)
+{
+    const std::lock_guard<std::mutex> guard(agreement->lock);
+    agreement->flag = flag;
+    agreement->speculative = speculative;
+    if (speculative)
+        agreement->epoch++;
+    agreement->version = get_version();
+    MPIX_Comm_iagree(cur_comm, &(agreement->flag), &(agreement->request));
+}
+
+bool ComplexComm::finish_agreement(const bool wait, int* flag, int* epoch, int* version)
+{
+    const std::lock_guard<std::mutex> guard(agreement->lock);
+    *flag = 1;
+    *epoch = 0;
+    *version = agreement->version;
+    if (agreement->request == MPI_REQUEST_NULL)
+        return true;
+    if (agreement->speculative)
+        *epoch = agreement->epoch;
+    int done = 1, rc;
+    if (wait)
+        rc = PMPI_Wait(&(agreement->request), MPI_STATUS_IGNORE);
+    else
+        rc = PMPI_Test(&(agreement->request), &done, MPI_STATUS_IGNORE);
+    if (rc != MPI_SUCCESS)
+    {
+        // The agreement itself was hit by a failure: the code is only known to this rank, while
+        // the flag is still the same on all the survivors, so the outcome comes from the flag
+        legio::log("Pending agreement completed with an error", LogLevel::errors_and_info);
+        agreement->request = MPI_REQUEST_NULL;
+        done = 1;
+    }
+    if (done)
+        *flag = agreement->flag;
+    return done;
+}
+
 MPI_Group ComplexComm::get_group()
 {
-    return group;
+    return *group;
 }
 
 MPI_Comm ComplexComm::get_alias()
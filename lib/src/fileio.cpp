@@ -7,9 +7,14 @@
 #include "context.hpp"
 #include "log.hpp"
 #include "mpi-ext.h"
+#include "resilient_call.hpp"
 
 using namespace legio;
 
+// Collective file calls synchronize the alias first, as opening the file does
+using FileCollective = CallPolicy<Recovery::agree, false, true>;
+using FileOrdered = CallPolicy<Recovery::none, false, true>;
+
 int MPI_File_open(MPI_Comm comm, const char* filename, int amode, MPI_Info info, MPI_File* mpi_fh)
 {
     int consequent_amode = amode;
@@ -33,13 +38,14 @@ int MPI_File_open(MPI_Comm comm, const char* filename, int amode, MPI_Info info,
     }
     while (1)
     {
-        int rc;
+        int rc, version = 0;
         bool flag = Context::get().m_comm.part_of(comm);
         std::function<int(MPI_Comm, MPI_File*)> func;
         if (flag)
         {
             ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
             MPI_Barrier(translated.get_alias());
+            version = translated.get_version();
             func = [filename, consequent_amode, info](MPI_Comm c, MPI_File* f) -> int {
                 int rc = PMPI_File_open(c, filename, consequent_amode, info, f);
                 MPI_File_set_errhandler(*f, MPI_ERRORS_RETURN);
@@ -60,7 +66,7 @@ int MPI_File_open(MPI_Comm comm, const char* filename, int amode, MPI_Info info,
                 return rc;
         }
         else
-            replace_comm(Context::get().m_comm.translate_into_complex(comm));
+            replace_comm(Context::get().m_comm.translate_into_complex(comm), version);
     }
 }
 
@@ -77,20 +83,10 @@ int MPI_File_read_at(MPI_File mpi_fh,
                      MPI_Datatype datatype,
                      MPI_Status* status)
 {
-    int rc;
-
-    bool flag = Context::get().m_comm.part_of(mpi_fh);
-    if (flag)
-    {
-        // MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-        MPI_File translated =
-            Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(mpi_fh);
-        rc = PMPI_File_read_at(translated, offset, buf, count, datatype, status);
-    }
-    else
-        rc = PMPI_File_read_at(mpi_fh, offset, buf, count, datatype, status);
-    legio::report_execution(rc, MPI_COMM_WORLD, "Read_at");
-    return rc;
+    Context::get().c_manager.expose(buf);
+    return resilient_call<LocalCall>("Read_at", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_read_at(fh, offset, buf, count, datatype, status);
+    });
 }
 
 int MPI_File_write_at(MPI_File mpi_fh,
@@ -100,19 +96,9 @@ int MPI_File_write_at(MPI_File mpi_fh,
                       MPI_Datatype datatype,
                       MPI_Status* status)
 {
-    int rc;
-    bool flag = Context::get().m_comm.part_of(mpi_fh);
-    if (flag)
-    {
-        // MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-        MPI_File translated =
-            Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(mpi_fh);
-        rc = PMPI_File_write_at(translated, offset, buf, count, datatype, status);
-    }
-    else
-        rc = PMPI_File_write_at(mpi_fh, offset, buf, count, datatype, status);
-    legio::report_execution(rc, MPI_COMM_WORLD, "Write_at");
-    return rc;
+    return resilient_call<LocalCall>("Write_at", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_write_at(fh, offset, buf, count, datatype, status);
+    });
 }
 
 int MPI_File_read_at_all(MPI_File mpi_fh,
@@ -122,31 +108,10 @@ int MPI_File_read_at_all(MPI_File mpi_fh,
                          MPI_Datatype datatype,
                          MPI_Status* status)
 {
-    while (1)
-    {
-        int rc;
-        bool flag = Context::get().m_comm.part_of(mpi_fh);
-        if (flag)
-        {
-            MPI_File translated =
-                Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(
-                    mpi_fh);
-            MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-            rc = PMPI_File_read_at_all(translated, offset, buf, count, datatype, status);
-        }
-        else
-            rc = PMPI_File_read_at_all(mpi_fh, offset, buf, count, datatype, status);
-        legio::report_execution(rc, MPI_COMM_WORLD, "Read_at_all");
-        if (flag)
-        {
-            agree_and_eventually_replace(&rc,
-                                         Context::get().m_comm.get_complex_from_structure(mpi_fh));
-            if (rc == MPI_SUCCESS)
-                return rc;
-        }
-        else
-            return rc;
-    }
+    Context::get().c_manager.expose(buf);
+    return resilient_call<FileCollective>("Read_at_all", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_read_at_all(fh, offset, buf, count, datatype, status);
+    });
 }
 
 int MPI_File_write_at_all(MPI_File mpi_fh,
@@ -156,69 +121,28 @@ int MPI_File_write_at_all(MPI_File mpi_fh,
                           MPI_Datatype datatype,
                           MPI_Status* status)
 {
-    while (1)
-    {
-        int rc;
-        bool flag = Context::get().m_comm.part_of(mpi_fh);
-        if (flag)
-        {
-            MPI_File translated =
-                Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(
-                    mpi_fh);
-            MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-            rc = PMPI_File_write_at_all(translated, offset, buf, count, datatype, status);
-        }
-        else
-            rc = PMPI_File_write_at_all(mpi_fh, offset, buf, count, datatype, status);
-        legio::report_execution(rc, MPI_COMM_WORLD, "Write_at_all");
-        if (flag)
-        {
-            agree_and_eventually_replace(&rc,
-                                         Context::get().m_comm.get_complex_from_structure(mpi_fh));
-            if (rc == MPI_SUCCESS)
-                return rc;
-        }
-        else
-            return rc;
-    }
+    return resilient_call<FileCollective>("Write_at_all", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_write_at_all(fh, offset, buf, count, datatype, status);
+    });
 }
 
 int MPI_File_seek(MPI_File mpi_fh, MPI_Offset offset, int whence)
 {
-    int rc;
-    bool flag = Context::get().m_comm.part_of(mpi_fh);
-    if (flag)
-    {
-        // MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-        MPI_File translated =
-            Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(mpi_fh);
-        rc = PMPI_File_seek(translated, offset, whence);
-    }
-    else
-        rc = PMPI_File_seek(mpi_fh, offset, whence);
-    legio::report_execution(rc, MPI_COMM_WORLD, "File_seek");
-    return rc;
+    return resilient_call<LocalCall>("File_seek", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_seek(fh, offset, whence);
+    });
 }
 
 int MPI_File_get_position(MPI_File mpi_fh, MPI_Offset* offset)
 {
-    int rc;
-    bool flag = Context::get().m_comm.part_of(mpi_fh);
-    if (flag)
-    {
-        MPI_File translated =
-            Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(mpi_fh);
-        rc = PMPI_File_get_position(translated, offset);
-    }
-    else
-        rc = PMPI_File_get_position(mpi_fh, offset);
-    legio::report_execution(rc, MPI_COMM_WORLD, "File_get_position");
-    return rc;
+    return resilient_call<LocalCall>("File_get_position", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_get_position(fh, offset);
+    });
 }
 
 int MPI_File_seek_shared(MPI_File mpi_fh, MPI_Offset offset, int whence)
 {
-    int rc;
+    int rc, version = 0;
     while (1)
     {
         MPI_Offset starting_offset;
@@ -226,6 +150,7 @@ int MPI_File_seek_shared(MPI_File mpi_fh, MPI_Offset offset, int whence)
         if (flag)
         {
             MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
+            version = Context::get().m_comm.get_complex_from_structure(mpi_fh).get_version();
             MPI_File translated =
                 Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(
                     mpi_fh);
@@ -237,8 +162,8 @@ int MPI_File_seek_shared(MPI_File mpi_fh, MPI_Offset offset, int whence)
         legio::report_execution(rc, MPI_COMM_WORLD, "File_seek_shared");
         if (flag)
         {
-            agree_and_eventually_replace(&rc,
-                                         Context::get().m_comm.get_complex_from_structure(mpi_fh));
+            agree_and_eventually_replace(
+                &rc, Context::get().m_comm.get_complex_from_structure(mpi_fh), version);
             if (rc == MPI_SUCCESS)
                 return rc;
             else
@@ -256,20 +181,9 @@ int MPI_File_seek_shared(MPI_File mpi_fh, MPI_Offset offset, int whence)
 
 int MPI_File_get_position_shared(MPI_File mpi_fh, MPI_Offset* offset)
 {
-    int rc;
-    bool flag = Context::get().m_comm.part_of(mpi_fh);
-    if (flag)
-    {
-        MPI_File translated =
-            Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(mpi_fh);
-        // MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-        rc = PMPI_File_get_position_shared(translated, offset);
-    }
-    else
-        rc = PMPI_File_get_position_shared(mpi_fh, offset);
-
-    legio::report_execution(rc, MPI_COMM_WORLD, "File_get_position_shared");
-    return rc;
+    return resilient_call<LocalCall>("File_get_position_shared", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_get_position_shared(fh, offset);
+    });
 }
 
 int MPI_File_read_all(MPI_File mpi_fh,
@@ -278,31 +192,10 @@ int MPI_File_read_all(MPI_File mpi_fh,
                       MPI_Datatype datatype,
                       MPI_Status* status)
 {
-    while (1)
-    {
-        int rc;
-        bool flag = Context::get().m_comm.part_of(mpi_fh);
-        if (flag)
-        {
-            MPI_File translated =
-                Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(
-                    mpi_fh);
-            MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-            rc = PMPI_File_read_all(translated, buf, count, datatype, status);
-        }
-        else
-            rc = PMPI_File_read_all(mpi_fh, buf, count, datatype, status);
-        legio::report_execution(rc, MPI_COMM_WORLD, "File_read_all");
-        if (flag)
-        {
-            agree_and_eventually_replace(&rc,
-                                         Context::get().m_comm.get_complex_from_structure(mpi_fh));
-            if (rc == MPI_SUCCESS)
-                return rc;
-        }
-        else
-            return rc;
-    }
+    Context::get().c_manager.expose(buf);
+    return resilient_call<FileCollective>("File_read_all", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_read_all(fh, buf, count, datatype, status);
+    });
 }
 
 int MPI_File_write_all(MPI_File mpi_fh,
@@ -311,32 +204,9 @@ int MPI_File_write_all(MPI_File mpi_fh,
                        MPI_Datatype datatype,
                        MPI_Status* status)
 {
-    while (1)
-    {
-        int rc;
-        bool flag = Context::get().m_comm.part_of(mpi_fh);
-        if (flag)
-        {
-            MPI_File translated =
-                Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(
-                    mpi_fh);
-            MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-            rc = PMPI_File_write_all(translated, buf, count, datatype, status);
-        }
-        else
-            rc = PMPI_File_write_all(mpi_fh, buf, count, datatype, status);
-
-        legio::report_execution(rc, MPI_COMM_WORLD, "File_write_all");
-        if (flag)
-        {
-            agree_and_eventually_replace(&rc,
-                                         Context::get().m_comm.get_complex_from_structure(mpi_fh));
-            if (rc == MPI_SUCCESS)
-                return rc;
-        }
-        else
-            return rc;
-    }
+    return resilient_call<FileCollective>("File_write_all", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_write_all(fh, buf, count, datatype, status);
+    });
 }
 
 int MPI_File_set_view(MPI_File mpi_fh,
@@ -346,48 +216,17 @@ int MPI_File_set_view(MPI_File mpi_fh,
                       char* datarep,
                       MPI_Info info)
 {
-    while (1)
-    {
-        int rc;
-        bool flag = Context::get().m_comm.part_of(mpi_fh);
-        if (flag)
-        {
-            MPI_File translated =
-                Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(
-                    mpi_fh);
-            MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-            rc = PMPI_File_set_view(translated, disp, etype, filetype, datarep, info);
-        }
-        else
-            rc = PMPI_File_set_view(mpi_fh, disp, etype, filetype, datarep, info);
-        legio::report_execution(rc, MPI_COMM_WORLD, "File_set_view");
-        if (flag)
-        {
-            agree_and_eventually_replace(&rc,
-                                         Context::get().m_comm.get_complex_from_structure(mpi_fh));
-            if (rc == MPI_SUCCESS)
-                return rc;
-        }
-        else
-            return rc;
-    }
+    return resilient_call<FileCollective>("File_set_view", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_set_view(fh, disp, etype, filetype, datarep, info);
+    });
 }
 
 int MPI_File_read(MPI_File mpi_fh, void* buf, int count, MPI_Datatype datatype, MPI_Status* status)
 {
-    int rc;
-    bool flag = Context::get().m_comm.part_of(mpi_fh);
-    if (flag)
-    {
-        MPI_File translated =
-            Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(mpi_fh);
-        // MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-        rc = PMPI_File_read(translated, buf, count, datatype, status);
-    }
-    else
-        rc = PMPI_File_read(mpi_fh, buf, count, datatype, status);
-    legio::report_execution(rc, MPI_COMM_WORLD, "File_read");
-    return rc;
+    Context::get().c_manager.expose(buf);
+    return resilient_call<LocalCall>("File_read", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_read(fh, buf, count, datatype, status);
+    });
 }
 
 int MPI_File_write(MPI_File mpi_fh,
@@ -396,19 +235,9 @@ int MPI_File_write(MPI_File mpi_fh,
                    MPI_Datatype datatype,
                    MPI_Status* status)
 {
-    int rc;
-    bool flag = Context::get().m_comm.part_of(mpi_fh);
-    if (flag)
-    {
-        MPI_File translated =
-            Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(mpi_fh);
-        // MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-        rc = PMPI_File_write(translated, buf, count, datatype, status);
-    }
-    else
-        rc = PMPI_File_write(mpi_fh, buf, count, datatype, status);
-    legio::report_execution(rc, MPI_COMM_WORLD, "File_write");
-    return rc;
+    return resilient_call<LocalCall>("File_write", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_write(fh, buf, count, datatype, status);
+    });
 }
 
 int MPI_File_read_shared(MPI_File mpi_fh,
@@ -417,20 +246,10 @@ int MPI_File_read_shared(MPI_File mpi_fh,
                          MPI_Datatype datatype,
                          MPI_Status* status)
 {
-    int rc;
-    bool flag = Context::get().m_comm.part_of(mpi_fh);
-    if (flag)
-    {
-        MPI_File translated =
-            Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(mpi_fh);
-        // MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-        rc = PMPI_File_read_shared(translated, buf, count, datatype, status);
-    }
-    else
-        rc = PMPI_File_read_shared(mpi_fh, buf, count, datatype, status);
-
-    legio::report_execution(rc, MPI_COMM_WORLD, "File_read_shared");
-    return rc;
+    Context::get().c_manager.expose(buf);
+    return resilient_call<LocalCall>("File_read_shared", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_read_shared(fh, buf, count, datatype, status);
+    });
 }
 
 int MPI_File_write_shared(MPI_File mpi_fh,
@@ -439,20 +258,9 @@ int MPI_File_write_shared(MPI_File mpi_fh,
                           MPI_Datatype datatype,
                           MPI_Status* status)
 {
-    int rc;
-    bool flag = Context::get().m_comm.part_of(mpi_fh);
-    if (flag)
-    {
-        MPI_File translated =
-            Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(mpi_fh);
-        // MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-        rc = PMPI_File_write_shared(translated, buf, count, datatype, status);
-    }
-    else
-        rc = PMPI_File_write_shared(mpi_fh, buf, count, datatype, status);
-
-    legio::report_execution(rc, MPI_COMM_WORLD, "File_write_shared");
-    return rc;
+    return resilient_call<LocalCall>("File_write_shared", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_write_shared(fh, buf, count, datatype, status);
+    });
 }
 
 int MPI_File_read_ordered(MPI_File mpi_fh,
@@ -461,19 +269,10 @@ int MPI_File_read_ordered(MPI_File mpi_fh,
                           MPI_Datatype datatype,
                           MPI_Status* status)
 {
-    int rc;
-    bool flag = Context::get().m_comm.part_of(mpi_fh);
-    if (flag)
-    {
-        MPI_File translated =
-            Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(mpi_fh);
-        MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-        rc = PMPI_File_read_ordered(translated, buf, count, datatype, status);
-    }
-    else
-        rc = PMPI_File_read_ordered(mpi_fh, buf, count, datatype, status);
-    legio::report_execution(rc, MPI_COMM_WORLD, "File_read_ordered");
-    return rc;
+    Context::get().c_manager.expose(buf);
+    return resilient_call<FileOrdered>("File_read_ordered", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_read_ordered(fh, buf, count, datatype, status);
+    });
 }
 
 int MPI_File_write_ordered(MPI_File mpi_fh,
@@ -482,85 +281,35 @@ int MPI_File_write_ordered(MPI_File mpi_fh,
                            MPI_Datatype datatype,
                            MPI_Status* status)
 {
-    int rc;
-    bool flag = Context::get().m_comm.part_of(mpi_fh);
-    if (flag)
-    {
-        MPI_File translated =
-            Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(mpi_fh);
-        MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-        rc = PMPI_File_write_ordered(translated, buf, count, datatype, status);
-    }
-    else
-        rc = PMPI_File_write_ordered(mpi_fh, buf, count, datatype, status);
-    legio::report_execution(rc, MPI_COMM_WORLD, "File_write_ordered");
-    return rc;
+    return resilient_call<FileOrdered>("File_write_ordered", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_write_ordered(fh, buf, count, datatype, status);
+    });
 }
 
 int MPI_File_sync(MPI_File mpi_fh)
 {
-    int rc;
-    bool flag = Context::get().m_comm.part_of(mpi_fh);
-    if (flag)
-    {
-        MPI_File translated =
-            Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(mpi_fh);
-        // MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-        rc = PMPI_File_sync(translated);
-    }
-    else
-        rc = PMPI_File_sync(mpi_fh);
-    legio::report_execution(rc, MPI_COMM_WORLD, "File_sync");
-    return rc;
+    return resilient_call<LocalCall>("File_sync", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_sync(fh);
+    });
 }
 
 int MPI_File_get_size(MPI_File mpi_fh, MPI_Offset* size)
 {
-    int rc;
-    bool flag = Context::get().m_comm.part_of(mpi_fh);
-    if (flag)
-    {
-        MPI_File translated =
-            Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(mpi_fh);
-        // MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-        rc = PMPI_File_get_size(translated, size);
-    }
-    else
-        rc = PMPI_File_get_size(mpi_fh, size);
-    legio::report_execution(rc, MPI_COMM_WORLD, "File_get_size");
-    return rc;
+    return resilient_call<LocalCall>("File_get_size", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_get_size(fh, size);
+    });
 }
 
 int MPI_File_get_type_extent(MPI_File mpi_fh, MPI_Datatype datatype, MPI_Aint* extent)
 {
-    int rc;
-    bool flag = Context::get().m_comm.part_of(mpi_fh);
-    if (flag)
-    {
-        MPI_File translated =
-            Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(mpi_fh);
-        // MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-        rc = PMPI_File_get_type_extent(translated, datatype, extent);
-    }
-    else
-        rc = PMPI_File_get_type_extent(mpi_fh, datatype, extent);
-    legio::report_execution(rc, MPI_COMM_WORLD, "File_get_type_extent");
-    return rc;
+    return resilient_call<LocalCall>("File_get_type_extent", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_get_type_extent(fh, datatype, extent);
+    });
 }
 
 int MPI_File_set_size(MPI_File mpi_fh, MPI_Offset size)
 {
-    int rc;
-    bool flag = Context::get().m_comm.part_of(mpi_fh);
-    if (flag)
-    {
-        MPI_File translated =
-            Context::get().m_comm.get_complex_from_structure(mpi_fh).translate_structure(mpi_fh);
-        // MPI_Barrier(Context::get().m_comm.get_complex_from_structure(mpi_fh).get_alias());
-        rc = PMPI_File_set_size(translated, size);
-    }
-    else
-        rc = PMPI_File_set_size(mpi_fh, size);
-    legio::report_execution(rc, MPI_COMM_WORLD, "File_set_size");
-    return rc;
+    return resilient_call<LocalCall>("File_set_size", mpi_fh, [&](MPI_File fh) {
+        return PMPI_File_set_size(fh, size);
+    });
 }
\ No newline at end of file
@@ -1,16 +1,15 @@
 #include <mpi.h>
 #include <signal.h>
-#include <shared_mutex>
-#include <thread>
 #include "comm_manipulation.hpp"
 #include "complex_comm.hpp"
 #include "context.hpp"
+#include "group_cache.hpp"
 #include "intercomm_utils.hpp"
 #include "log.hpp"
 #include "mpi-ext.h"
+#include "resilient_call.hpp"
 #include "restart_routines.hpp"
 
-extern std::shared_timed_mutex failure_mtx;
 using namespace legio;
 
 int MPI_Init(int* argc, char*** argv)
@@ -20,9 +19,14 @@ int MPI_Init(int* argc, char*** argv)
         int provided;
         int rc = PMPI_Init_thread(argc, argv, MPI_THREAD_MULTIPLE, &provided);
         initialization(argc, argv);
+        if constexpr (BuildOptions::spare_pool_size > 0)
+            if (!Context::get().r_manager.is_respawned())
+                create_spare_pool(*argc, *argv);
+        if constexpr (BuildOptions::replicate_critical)
+            if (!Context::get().r_manager.is_respawned())
+                Context::get().rep_manager.spawn(*argc, *argv);
 
-        std::thread repair(loop_repair_failures);
-        repair.detach();
+        start_repair_listener();
         return rc;
     }
     else
@@ -42,7 +46,26 @@ int MPI_Init_thread(int* argc, char*** argv, int required, int* provided)
 
 int MPI_Finalize()
 {
+    if constexpr (BuildOptions::replicate_critical)
+        if (Context::get().rep_manager.is_replica() && Context::get().rep_manager.wait_release())
+        {
+            // Never promoted, the primary finalizes the world
+            stop_repair_listener();
+            PMPI_Finalize();
+            finalization();
+            return MPI_SUCCESS;
+        }
     MPI_Barrier(MPI_COMM_WORLD);
+    if constexpr (BuildOptions::pending_agreements)
+        Context::get().m_comm.wait_agreements();
+    if constexpr (BuildOptions::with_restart)
+    {
+        stop_repair_listener();
+        Context::get().c_manager.close();
+        release_spare_pool();
+        if constexpr (BuildOptions::replicate_critical)
+            Context::get().rep_manager.release();
+    }
     PMPI_Finalize();
     finalization();
     return MPI_SUCCESS;
@@ -63,7 +86,8 @@ int MPI_Comm_rank(MPI_Comm comm, int* rank)
                 return MPI_SUCCESS;
             }
             // RespawnMulticomm* respawned_comms = dynamic_cast<RespawnMulticomm*>(cur_comms);
-            auto supported_comms = Context::get().r_manager.access_supported_comms_respawned();
+            const auto& supported_comms =
+                Context::get().r_manager.access_supported_comms_respawned();
             auto found_comm = supported_comms.find(c2f<MPI_Comm>(comm));
 
             if (found_comm == supported_comms.end())
@@ -87,11 +111,12 @@ int MPI_Comm_size(MPI_Comm comm, int* size)
         else
         {
             // RespawnMulticomm* respawned_comms = dynamic_cast<RespawnMulticomm*>(cur_comms);
-            auto supported_comms = Context::get().r_manager.access_supported_comms_respawned();
+            const auto& supported_comms =
+                Context::get().r_manager.access_supported_comms_respawned();
             auto found_comm = supported_comms.find(MPI_Comm_c2f(comm));
 
             if (comm == MPI_COMM_WORLD)
-                *size = Context::get().r_manager.get_ranks().size();
+                *size = Context::get().r_manager.get_world_size();
             else if (found_comm == supported_comms.end())
                 return PMPI_Comm_size(comm, size);
             else
@@ -122,30 +147,35 @@ int MPI_Comm_dup(MPI_Comm comm, MPI_Comm* newcomm)
 {
     while (1)
     {
-        int rc;
-        bool flag = Context::get().m_comm.part_of(comm);
-        failure_mtx.lock_shared();
-        if (flag)
-        {
-            ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
-            rc = PMPI_Comm_dup(translated.get_comm(), newcomm);
-        }
-        else
-            rc = PMPI_Comm_dup(comm, newcomm);
-        failure_mtx.unlock_shared();
-        legio::report_execution(rc, comm, "Comm_dup");
-        if (flag)
-        {
-            agree_and_eventually_replace(&rc, Context::get().m_comm.translate_into_complex(comm));
-            if (rc == MPI_SUCCESS)
-            {
-                MPI_Comm_set_errhandler(*newcomm, MPI_ERRORS_RETURN);
-                bool result = Context::get().m_comm.add_comm(*newcomm);
-                if (result)
-                    return rc;
-            }
-        }
-        else
+        int rc = resilient_call<AgreedCall>("Comm_dup", comm,
+                                            [&](MPI_Comm c) { return PMPI_Comm_dup(c, newcomm); });
+        if (rc != MPI_SUCCESS || !Context::get().m_comm.part_of(comm))
+            return rc;
+        ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
+        MPI_Comm_set_errhandler(*newcomm, MPI_ERRORS_RETURN);
+        bool result = Context::get().m_comm.add_comm(*newcomm, translated.get_policy());
+        if (result)
+            return rc;
+    }
+}
+
+int MPI_Comm_dup_with_info(MPI_Comm comm, MPI_Info info, MPI_Comm* newcomm)
+{
+    while (1)
+    {
+        int rc = resilient_call<AgreedCall>("Comm_dup_with_info", comm, [&](MPI_Comm c) {
+            return PMPI_Comm_dup_with_info(c, info, newcomm);
+        });
+        if (rc != MPI_SUCCESS || !Context::get().m_comm.part_of(comm))
+            return rc;
+        ResiliencyPolicy policy = Context::get().m_comm.translate_into_complex(comm).get_policy();
+        policy.update(info);
+        // Left to the MPI library, as if created from a comm not handled by Legio
+        if (policy.unmanaged)
+            return rc;
+        MPI_Comm_set_errhandler(*newcomm, MPI_ERRORS_RETURN);
+        bool result = Context::get().m_comm.add_comm(*newcomm, policy);
+        if (result)
             return rc;
     }
 }
@@ -156,9 +186,9 @@ int MPI_Comm_create(MPI_Comm comm, MPI_Group group, MPI_Comm* newcomm)
     {
         int rc;
         bool flag = Context::get().m_comm.part_of(comm);
-        failure_mtx.lock_shared();
         if (flag)
         {
+            // No lock held here: the split is a Legio call, whose recovery replaces comm
             int rank;
             MPI_Group_rank(group, &rank);
             rank = (rank != MPI_UNDEFINED);
@@ -171,19 +201,19 @@ int MPI_Comm_create(MPI_Comm comm, MPI_Group group, MPI_Comm* newcomm)
                 MPI_Comm_free(&temp);
                 *newcomm = MPI_COMM_NULL;
             }
-            failure_mtx.unlock_shared();
             return rc;
         }
         else
         {
+            Context::get().m_comm.lock_shared(comm);
             rc = PMPI_Comm_create(comm, group, newcomm);
-            failure_mtx.unlock_shared();
+            Context::get().m_comm.unlock_shared(comm);
             return rc;
         }
     }
 }
 
-void check_group(legio::ComplexComm cur_comm,
+void check_group(legio::ComplexComm& cur_comm,
                  MPI_Group group,
                  MPI_Group* first_clean,
                  MPI_Group* second_clean)
@@ -195,6 +225,7 @@ void check_group(legio::ComplexComm cur_comm,
     MPI_Group_difference(original_group, actual_group, &failed_group);
     MPI_Group_difference(group, failed_group, first_clean);
     MPI_Group_free(&failed_group);
+    MPI_Group_free(&actual_group);
     // int size;
     // MPI_Group_size(*first_clean, &size);
     // printf("___%d___ First clean, size: %d\n", own_rank, size);
@@ -214,27 +245,57 @@ int MPI_Comm_create_group(MPI_Comm comm, MPI_Group group, int tag, MPI_Comm* new
 {
     int rc;
     bool flag = Context::get().m_comm.part_of(comm);
-    failure_mtx.lock_shared();
+    Context::get().m_comm.lock_shared(comm);
     if (flag)
     {
         ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
-        MPI_Group first_clean, second_clean;
-        check_group(translated, group, &first_clean, &second_clean);
-        int size_first, size_second;
-        MPI_Group_size(first_clean, &size_first);
-        MPI_Group_size(second_clean, &size_second);
-        if (size_first != size_second)
+        GroupCache& cache = translated.get_group_cache();
+        auto signature = GroupCache::signature(group, translated.get_group());
+        MPI_Group cached;
+        if (cache.find(signature, &cached))
         {
-            legio::log("\n\n FAILED!!!!\n\n", LogLevel::errors_only);
-            rc = MPI_ERR_PROC_FAILED;
-            *newcomm = MPI_COMM_NULL;
+            // Group already checked since the last replacement. A failure is not recovered here,
+            // as the members that did not see it would go on alone: the comm is revoked, so that
+            // every rank replaces it and the next create checks the group again
+            rc = PMPI_Comm_create_group(translated.get_comm(), cached, tag, newcomm);
+            if (rc != MPI_SUCCESS)
+            {
+                MPIX_Comm_revoke(translated.get_comm());
+                *newcomm = MPI_COMM_NULL;
+            }
         }
         else
-            rc = PMPI_Comm_create_group(translated.get_comm(), second_clean, tag, newcomm);
+        {
+            MPI_Group first_clean, second_clean;
+            check_group(translated, group, &first_clean, &second_clean);
+            int size_first, size_second;
+            MPI_Group_size(first_clean, &size_first);
+            MPI_Group_size(second_clean, &size_second);
+            MPI_Group_free(&first_clean);
+            if (size_first != size_second)
+            {
+                legio::log("\n\n FAILED!!!!\n\n", LogLevel::errors_only);
+                rc = MPI_ERR_PROC_FAILED;
+                *newcomm = MPI_COMM_NULL;
+                MPI_Group_free(&second_clean);
+            }
+            else
+            {
+                rc = PMPI_Comm_create_group(translated.get_comm(), second_clean, tag, newcomm);
+                if (rc == MPI_SUCCESS)
+                    cache.insert(signature, second_clean);
+                else
+                {
+                    // Members where the create succeeded would keep the group cached
+                    MPIX_Comm_revoke(translated.get_comm());
+                    MPI_Group_free(&second_clean);
+                }
+            }
+        }
     }
     else
         rc = PMPI_Comm_create_group(comm, group, tag, newcomm);
-    failure_mtx.unlock_shared();
+    Context::get().m_comm.unlock_shared(comm);
     legio::report_execution(rc, comm, "Comm_create_group");
     if (flag && rc == MPI_SUCCESS && *newcomm != MPI_COMM_NULL)
     {
@@ -249,7 +310,8 @@ int MPI_Comm_create_group(MPI_Comm comm, MPI_Group group, int tag, MPI_Comm* new
 int MPI_Comm_disconnect(MPI_Comm* comm)
 {
     std::function<int(MPI_Comm*)> func = [](MPI_Comm* a) { return PMPI_Comm_disconnect(a); };
-    Context::get().m_comm.remove(*comm, func);
+    if (Context::get().m_comm.part_of(*comm))
+        Context::get().m_comm.remove(*comm, func);
     func(comm);
     return MPI_SUCCESS;
 }
@@ -257,7 +319,8 @@ int MPI_Comm_disconnect(MPI_Comm* comm)
 int MPI_Comm_free(MPI_Comm* comm)
 {
     std::function<int(MPI_Comm*)> func = [](MPI_Comm* a) { return PMPI_Comm_free(a); };
-    Context::get().m_comm.remove(*comm, func);
+    if (Context::get().m_comm.part_of(*comm))
+        Context::get().m_comm.remove(*comm, func);
     func(comm);
     return MPI_SUCCESS;
 }
@@ -266,30 +329,32 @@ int MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm* newcomm)
 {
     while (1)
     {
-        int rc;
-        bool flag = Context::get().m_comm.part_of(comm);
-        failure_mtx.lock_shared();
-        if (flag)
-        {
-            ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
-            rc = PMPI_Comm_split(translated.get_comm(), color, key, newcomm);
-        }
-        else
-            rc = PMPI_Comm_split(comm, color, key, newcomm);
-        failure_mtx.unlock_shared();
-        legio::report_execution(rc, comm, "Comm_split");
-        if (flag)
-        {
-            agree_and_eventually_replace(&rc, Context::get().m_comm.translate_into_complex(comm));
-            if (rc == MPI_SUCCESS)
-            {
-                MPI_Comm_set_errhandler(*newcomm, MPI_ERRORS_RETURN);
-                bool result = Context::get().m_comm.add_comm(*newcomm);
-                if (result)
-                    return rc;
-            }
-        }
-        else
+        int rc = resilient_call<AgreedCall>("Comm_split", comm, [&](MPI_Comm c) {
+            return PMPI_Comm_split(c, color, key, newcomm);
+        });
+        if (rc != MPI_SUCCESS || !Context::get().m_comm.part_of(comm))
+            return rc;
+        ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
+        MPI_Comm_set_errhandler(*newcomm, MPI_ERRORS_RETURN);
+        bool result = Context::get().m_comm.add_comm(*newcomm, translated.get_policy());
+        if (result)
+            return rc;
+    }
+}
+
+int MPI_Comm_split_type(MPI_Comm comm, int split_type, int key, MPI_Info info, MPI_Comm* newcomm)
+{
+    while (1)
+    {
+        int rc = resilient_call<AgreedCall>("Comm_split_type", comm, [&](MPI_Comm c) {
+            return PMPI_Comm_split_type(c, split_type, key, info, newcomm);
+        });
+        if (rc != MPI_SUCCESS || !Context::get().m_comm.part_of(comm) || *newcomm == MPI_COMM_NULL)
+            return rc;
+        ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
+        MPI_Comm_set_errhandler(*newcomm, MPI_ERRORS_RETURN);
+        bool result = Context::get().m_comm.add_comm(*newcomm, translated.get_policy());
+        if (result)
             return rc;
     }
 }
@@ -303,16 +368,15 @@ int MPI_Intercomm_create(MPI_Comm local_comm,
 {
     while (1)
     {
-        int rc, own_rank;
+        int rc, own_rank, version = 0;
         bool flag = Context::get().m_comm.part_of(local_comm);
         PMPI_Comm_rank(local_comm, &own_rank);
-        // MPI_Barrier(local_comm);
         MPI_Comm remote_comm = MPI_COMM_NULL;
-        failure_mtx.lock_shared();
+        int remote_high = 0;
+        // The Legio calls on the leaders' comm and the barrier run before taking the lock, as
+        // their recovery replaces the comms
         if (flag)
         {
-            ComplexComm& translated = Context::get().m_comm.translate_into_complex(local_comm);
-            int local_root = translate_ranks(local_leader, translated);
             if (own_rank == local_leader)
             {
                 MPI_Group remote_group, shrink_group;
@@ -323,29 +387,31 @@ int MPI_Intercomm_create(MPI_Comm local_comm,
                                   (remote_rank < remote_leader ? remote_leader : remote_rank)};
                 MPI_Group_incl(remote_group, 2, indexes, &shrink_group);
                 rc = MPI_Comm_create_group(peer_comm, shrink_group, 0, &remote_comm);
-                // TODO handle faults of root nodes
-                MPI_Barrier(local_comm);
-                rc =
-                    PMPI_Intercomm_create(translated.get_comm(), local_root, remote_comm,
-                                          (remote_rank < remote_leader ? 1 : 0), tag, newintercomm);
-                MPI_Comm_free(&remote_comm);
-            }
-            else
-            {
-                MPI_Barrier(local_comm);
-                rc = PMPI_Intercomm_create(translated.get_comm(), local_root, remote_comm, 0, tag,
-                                           newintercomm);
+                remote_high = remote_rank < remote_leader ? 1 : 0;
             }
+            // TODO handle faults of root nodes
+            MPI_Barrier(local_comm);
+        }
+        Context::get().m_comm.lock_shared(local_comm);
+        if (flag)
+        {
+            ComplexComm& translated = Context::get().m_comm.translate_into_complex(local_comm);
+            version = translated.get_version();
+            int local_root = translate_ranks(local_leader, translated);
+            rc = PMPI_Intercomm_create(translated.get_comm(), local_root, remote_comm, remote_high,
+                                       tag, newintercomm);
         }
         else
             rc = PMPI_Intercomm_create(local_comm, local_leader, peer_comm, remote_leader, tag,
                                        newintercomm);
-        failure_mtx.unlock_shared();
+        Context::get().m_comm.unlock_shared(local_comm);
+        if (remote_comm != MPI_COMM_NULL)
+            MPI_Comm_free(&remote_comm);
         legio::report_execution(rc, local_comm, "Intercomm_create");
         if (flag)
         {
-            agree_and_eventually_replace(&rc,
-                                         Context::get().m_comm.translate_into_complex(local_comm));
+            agree_and_eventually_replace(
+                &rc, Context::get().m_comm.translate_into_complex(local_comm), version);
             if (rc == MPI_SUCCESS)
             {
                 MPI_Group local_group, remote_group;
@@ -366,22 +432,23 @@ int MPI_Intercomm_merge(MPI_Comm intercomm, int high, MPI_Comm* newintracomm)
 {
     while (1)
     {
-        int rc;
+        int rc, version = 0;
         bool flag = Context::get().m_comm.part_of(intercomm);
-        failure_mtx.lock_shared();
+        Context::get().m_comm.lock_shared(intercomm);
         if (flag)
         {
             ComplexComm& translated = Context::get().m_comm.translate_into_complex(intercomm);
+            version = translated.get_version();
             rc = PMPI_Intercomm_merge(translated.get_comm(), high, newintracomm);
         }
         else
             rc = PMPI_Intercomm_merge(intercomm, high, newintracomm);
-        failure_mtx.unlock_shared();
+        Context::get().m_comm.unlock_shared(intercomm);
         legio::report_execution(rc, intercomm, "Intercomm_merge");
         if (flag)
         {
-            agree_and_eventually_replace(&rc,
-                                         Context::get().m_comm.translate_into_complex(intercomm));
+            agree_and_eventually_replace(
+                &rc, Context::get().m_comm.translate_into_complex(intercomm), version);
             if (rc == MPI_SUCCESS)
             {
                 MPI_Comm_set_errhandler(*newintracomm, MPI_ERRORS_RETURN);
@@ -406,13 +473,14 @@ int MPI_Comm_spawn(const char* command,
 {
     while (1)
     {
-        int rc;
+        int rc, version = 0;
         bool flag = Context::get().m_comm.part_of(comm);
         int root_rank = root;
-        failure_mtx.lock_shared();
+        Context::get().m_comm.lock_shared(comm);
         if (flag)
         {
             ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
+            version = translated.get_version();
             root_rank = translate_ranks(root, translated);
             rc = PMPI_Comm_spawn(command, argv, maxprocs, info, root_rank, translated.get_comm(),
                                  intercomm, array_of_errcodes);
@@ -420,11 +488,12 @@ int MPI_Comm_spawn(const char* command,
         else
             rc = PMPI_Comm_spawn(command, argv, maxprocs, info, root, comm, intercomm,
                                  array_of_errcodes);
-        failure_mtx.unlock_shared();
+        Context::get().m_comm.unlock_shared(comm);
         legio::report_execution(rc, comm, "Comm_spawn");
         if (flag)
         {
-            agree_and_eventually_replace(&rc, Context::get().m_comm.translate_into_complex(comm));
+            agree_and_eventually_replace(&rc, Context::get().m_comm.translate_into_complex(comm),
+                                         version);
             if (rc == MPI_SUCCESS)
             {
                 MPI_Comm_set_errhandler(*intercomm, MPI_ERRORS_RETURN);
@@ -438,40 +507,20 @@ int MPI_Comm_spawn(const char* command,
 
 int MPI_Comm_set_info(MPI_Comm comm, MPI_Info info)
 {
-    while (1)
-    {
-        int rc;
-        bool flag = Context::get().m_comm.part_of(comm);
-        ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
-        failure_mtx.lock_shared();
-        if (flag)
-            rc = PMPI_Comm_set_info(translated.get_comm(), info);
-        else
-            rc = PMPI_Comm_set_info(comm, info);
-        failure_mtx.unlock_shared();
-        legio::report_execution(rc, comm, "Comm_set_info");
-        if (flag)
-        {
-            agree_and_eventually_replace(&rc, translated);
-            if (rc == MPI_SUCCESS)
-                return rc;
-        }
-        else
-            return rc;
-    }
+    int rc = resilient_call<AgreedCall>("Comm_set_info", comm,
+                                        [&](MPI_Comm c) { return PMPI_Comm_set_info(c, info); });
+    if (rc != MPI_SUCCESS || !Context::get().m_comm.part_of(comm))
+        return rc;
+    ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
+    translated.get_policy().update(info);
+    if (translated.get_policy().unmanaged)
+        release_comm(comm);
+    return rc;
 }
 
 int MPI_Comm_get_info(MPI_Comm comm, MPI_Info* info_used)
 {
-    int rc;
-    bool flag = Context::get().m_comm.part_of(comm);
-    ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
-    failure_mtx.lock_shared();
-    if (flag)
-        rc = PMPI_Comm_get_info(translated.get_comm(), info_used);
-    else
-        rc = PMPI_Comm_get_info(comm, info_used);
-    failure_mtx.unlock_shared();
-    legio::report_execution(rc, comm, "Comm_get_info");
-    return rc;
+    return resilient_call<LocalCall>("Comm_get_info", comm, [&](MPI_Comm c) {
+        return PMPI_Comm_get_info(c, info_used);
+    });
 }
\ No newline at end of file
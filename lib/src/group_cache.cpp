@@ -0,0 +1,69 @@
+#include "group_cache.hpp"
+#include <mutex>
+#include <numeric>
+#include <vector>
+#include "mpi.h"
+
+using namespace legio;
+
+GroupCache::~GroupCache()
+{
+    int finalized;
+    PMPI_Finalized(&finalized);
+    if (finalized)
+        return;
+    for (auto& entry : entries)
+        PMPI_Group_free(&(entry.second.clean));
+}
+
+std::vector<int> GroupCache::signature(MPI_Group group, MPI_Group reference)
+{
+    int size;
+    PMPI_Group_size(group, &size);
+    std::vector<int> ranks(size), result(size);
+    std::iota(ranks.begin(), ranks.end(), 0);
+    PMPI_Group_translate_ranks(group, size, ranks.data(), reference, result.data());
+    return result;
+}
+
+bool GroupCache::find(const std::vector<int>& signature, MPI_Group* clean)
+{
+    const std::lock_guard<std::mutex> guard(lock);
+    auto res = entries.find(signature);
+    if (res == entries.end())
+        return false;
+    if (res->second.epoch != epoch)
+    {
+        // Validated before the last replacement, the group has to be checked again
+        PMPI_Group_free(&(res->second.clean));
+        entries.erase(res);
+        return false;
+    }
+    *clean = res->second.clean;
+    return true;
+}
+
+void GroupCache::insert(const std::vector<int>& signature, MPI_Group clean)
+{
+    const std::lock_guard<std::mutex> guard(lock);
+    auto res = entries.find(signature);
+    if (res != entries.end())
+    {
+        PMPI_Group_free(&(res->second.clean));
+        res->second = {epoch, clean};
+        return;
+    }
+    entries.insert({signature, {epoch, clean}});
+}
+
+void GroupCache::advance_epoch()
+{
+    const std::lock_guard<std::mutex> guard(lock);
+    epoch++;
+}
+
+unsigned long GroupCache::get_epoch()
+{
+    const std::lock_guard<std::mutex> guard(lock);
+    return epoch;
+}
@@ -1,6 +1,9 @@
 extern "C" {
 #include "legio.h"
 }
+#include <algorithm>
+#include <vector>
+#include "comm_manipulation.hpp"
 #include "context.hpp"
 #include "intercomm_utils.hpp"
 #include "mpi.h"
@@ -16,13 +19,9 @@ void fault_number(MPI_Comm comm, int* size)
 
 void who_failed(MPI_Comm comm, int* size, int* ranks)
 {
-    MPI_Group failed, comm_group;
-    MPIX_Comm_failure_get_acked(comm, &failed);
-    PMPI_Group_size(failed, size);
-    PMPI_Comm_group(comm, &comm_group);
-    int i;
-    for (i = 0; i < *size && i < LEGIO_MAX_FAILS; i++)
-        PMPI_Group_translate_ranks(failed, 1, &i, comm_group, &(ranks[i]));
+    std::vector<int> failed = legio::acked_failures(comm);
+    *size = failed.size();
+    std::copy(failed.begin(), failed.end(), ranks);
 }
 
 int MPIX_Comm_agree_group(MPI_Comm comm, MPI_Group group, int* flag)
@@ -31,6 +30,12 @@ int MPIX_Comm_agree_group(MPI_Comm comm, MPI_Group group, int* flag)
     return MPI_SUCCESS;
 }
 
+int MPIX_Rollback_handler_set(MPIX_Rollback_function* handler)
+{
+    legio::set_rollback_handler(handler);
+    return MPI_SUCCESS;
+}
+
 #if WITH_SESSION
 int MPIX_Horizon_from_group(MPI_Group group)
 {
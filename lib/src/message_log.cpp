@@ -0,0 +1,128 @@
+#include "message_log.hpp"
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include "comm_manipulation.hpp"
+#include "complex_comm.hpp"
+#include "context.hpp"
+#include "log.hpp"
+#include "mpi.h"
+
+using namespace legio;
+
+// World rank of dest, -1 if the comm is not logged
+int MessageLog::to_world_rank(const int dest, ComplexComm& comm)
+{
+    if (comm.get_alias() == MPI_COMM_WORLD)
+        return dest;
+    const int index = Context::get().r_manager.get_supported_index(comm.get_alias_id());
+    if (index < 0)
+        return -1;
+    return Context::get().r_manager.supported_comms_vector[index].get_world_ranks()[dest];
+}
+
+void MessageLog::record(const void* buf,
+                        int count,
+                        MPI_Datatype datatype,
+                        int dest,
+                        int tag,
+                        ComplexComm& comm)
+{
+    const int world_rank = to_world_rank(dest, comm);
+    const auto& critical = Context::get().r_manager.get_respawn_list();
+    if (world_rank < 0 || std::find(critical.begin(), critical.end(), world_rank) == critical.end())
+        return;
+
+    Entry entry = {comm.get_alias(), dest, tag, Context::get().c_manager.get_generation()};
+    int size, position = 0;
+    PMPI_Pack_size(count, datatype, comm.get_comm(), &size);
+    entry.packed.resize(size);
+    PMPI_Pack(buf, count, datatype, entry.packed.data(), size, &position, comm.get_comm());
+    entry.packed.resize(position);
+
+    const std::lock_guard<std::mutex> guard(lock);
+    auto& peer = entries[world_rank];
+    auto& bytes = logged_bytes[world_rank];
+    bytes += entry.packed.size();
+    peer.push_back(std::move(entry));
+    // Bounded memory per peer: the oldest messages are dropped and cannot be replayed anymore
+    while (bytes > BuildOptions::message_log_size && !peer.empty())
+    {
+        bytes -= peer.front().packed.size();
+        peer.pop_front();
+        // Reported once until the next trim makes room again
+        if (overflowing.insert(world_rank).second)
+            legio::log("Message log full, dropping the oldest messages", LogLevel::errors_only);
+    }
+}
+
+void MessageLog::trim(const int generation)
+{
+    const std::lock_guard<std::mutex> guard(lock);
+    complete_replays();
+    // The buddy may still hold the previous generation if the last transfer did not complete
+    for (auto& peer : entries)
+        while (!peer.second.empty() && peer.second.front().generation < generation - 1)
+        {
+            logged_bytes[peer.first] -= peer.second.front().packed.size();
+            peer.second.pop_front();
+            overflowing.erase(peer.first);
+        }
+}
+
+void MessageLog::forget(MPI_Comm alias)
+{
+    const std::lock_guard<std::mutex> guard(lock);
+    for (auto& peer : entries)
+    {
+        auto& bytes = logged_bytes[peer.first];
+        auto kept = std::remove_if(peer.second.begin(), peer.second.end(),
+                                   [&bytes, alias](const Entry& entry) {
+                                       if (entry.alias != alias)
+                                           return false;
+                                       bytes -= entry.packed.size();
+                                       return true;
+                                   });
+        peer.second.erase(kept, peer.second.end());
+    }
+}
+
+void MessageLog::complete_replays()
+{
+    for (auto it = replaying.begin(); it != replaying.end();)
+    {
+        int flag = 0;
+        PMPI_Test(&(it->first), &flag, MPI_STATUS_IGNORE);
+        if (flag)
+            it = replaying.erase(it);
+        else
+            it++;
+    }
+}
+
+void MessageLog::replay(const std::vector<int>& respawned)
+{
+    const std::lock_guard<std::mutex> guard(lock);
+    complete_replays();
+    for (auto world_rank : respawned)
+    {
+        auto peer = entries.find(world_rank);
+        if (peer == entries.end())
+            continue;
+        const int restored = Context::get().c_manager.get_restored_generation(world_rank);
+        for (const auto& entry : peer->second)
+        {
+            if (entry.generation < restored)
+                continue;
+            ComplexComm& comm = Context::get().m_comm.translate_into_complex(entry.alias);
+            int dest_rank = translate_ranks(entry.dest, comm);
+            if (dest_rank == MPI_UNDEFINED)
+                continue;
+            // Sent from a copy, the entry may be trimmed before the receiver matches it
+            replaying.emplace_back(MPI_REQUEST_NULL, entry.packed);
+            PMPI_Isend(replaying.back().second.data(), replaying.back().second.size(),
+                       MPI_PACKED, dest_rank, entry.tag, comm.get_comm(),
+                       &(replaying.back().first));
+        }
+    }
+}
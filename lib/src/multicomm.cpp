@@ -8,6 +8,7 @@
 #include <unordered_map>
 #include "complex_comm.hpp"
 #include "config.hpp"
+#include "context.hpp"
 #include "mpi.h"
 extern "C" {
 #include "restart.h"
@@ -15,25 +16,28 @@ extern "C" {
 
 using namespace legio;
 
-int Multicomm::add_comm(MPI_Comm added)
+int Multicomm::add_comm(MPI_Comm added, const ResiliencyPolicy& policy)
 {
-    if (!is_respawned())
+    int id = c2f<MPI_Comm>(added);
+    MPI_Comm working = added;
+    // With LAZY_COMM_DUP the user comm is also the working one until its first repair, that
+    // provides the replacement; the world and self comms carry the internal traffic of Legio,
+    // so they keep their duplicate; respawned ranks get their comms already rebuilt
+    bool lazy = BuildOptions::lazy_comm_dup && added != MPI_COMM_WORLD && added != MPI_COMM_SELF;
+    if (!lazy && !is_respawned())
     {
-        int id = c2f<MPI_Comm>(added);
-        MPI_Comm temp;
-        PMPI_Comm_dup(added, &temp);
-        MPI_Comm_set_errhandler(temp, MPI_ERRORS_RETURN);
-        std::pair<int, ComplexComm> adding(id, ComplexComm(temp, id));
-        auto res = comms.insert(adding);
-        return res.second;
-    }
-    else
-    {
-        int id = c2f<MPI_Comm>(added);
-        std::pair<int, ComplexComm> adding(id, ComplexComm(added, id));
-        auto res = comms.insert(adding);
-        return res.second;
+        PMPI_Comm_dup(added, &working);
+        MPI_Comm_set_errhandler(working, MPI_ERRORS_RETURN);
     }
+    else if (lazy)
+        MPI_Comm_set_errhandler(working, MPI_ERRORS_RETURN);
+    std::pair<int, ComplexComm> adding(id, ComplexComm(working, id));
+    auto res = comms.insert(adding);
+    if (res.second)
+        res.first->second.get_policy() = policy;
+    else if (working != added)
+        PMPI_Comm_free(&working);
+    return res.second;
 }
 
 ComplexComm& Multicomm::translate_into_complex(MPI_Comm input)
@@ -58,8 +62,24 @@ void Multicomm::remove(MPI_Comm removed, std::function<int(MPI_Comm*)> destroyer
     // std::unordered_map<int, int>::iterator res = comms_order.find(id);
     if (res != comms.end())
     {
+        // A failed outcome replaces the comm and rolls back a speculative collective as on the
+        // other paths, the ranks that complete the agreement elsewhere take part in the same shrink
+        if constexpr (BuildOptions::pending_agreements)
+            complete_agreement(res->second, true);
+        // A respawned rank uses the user handle itself until the first repair, the caller frees it
         MPI_Comm target = res->second.get_comm();
-        destroyer(&target);
+        if (target != removed)
+            destroyer(&target);
+        // Structures built on the comm go back to the MPI library with it
+        for (auto& map : maps)
+            for (auto it = map.begin(); it != map.end();)
+                if (it->second == id)
+                    it = map.erase(it);
+                else
+                    it++;
+        if constexpr (BuildOptions::message_logging)
+            Context::get().m_log.forget(removed);
+        // Handlers and group go with the last copy of the ComplexComm
         comms.erase(id);
     }
     else
@@ -75,6 +95,45 @@ const bool Multicomm::part_of(MPI_Comm checked) const
     return res != comms.end();
 }
 
+const ResiliencyPolicy& Multicomm::get_policy(MPI_Comm comm)
+{
+    static const ResiliencyPolicy build_options;
+    auto res = comms.find(c2f<MPI_Comm>(comm));
+    if (res == comms.end())
+        return build_options;
+    return res->second.get_policy();
+}
+
+void Multicomm::lock_shared(MPI_Comm comm)
+{
+    // Comms not handled by Legio are never repaired
+    auto res = comms.find(c2f<MPI_Comm>(comm));
+    if (res == comms.end())
+        return;
+    // No operation starts before the agreement on the previous collective is over
+    lock_shared(res->second, true);
+}
+
+void Multicomm::lock_shared(ComplexComm& comm, const bool wait)
+{
+    if constexpr (BuildOptions::pending_agreements)
+        complete_agreement(comm, wait);
+    comm.lock_shared();
+}
+
+void Multicomm::unlock_shared(MPI_Comm comm)
+{
+    auto res = comms.find(c2f<MPI_Comm>(comm));
+    if (res != comms.end())
+        res->second.unlock_shared();
+}
+
+void Multicomm::wait_agreements()
+{
+    for (auto& comm : comms)
+        complete_agreement(comm.second, true);
+}
+
 void Multicomm::remove_structure(MPI_Win* win)
 {
     // assert(initialized);
@@ -1,16 +1,18 @@
 #include <mpi.h>
 #include <signal.h>
 #include <stdio.h>
-#include <shared_mutex>
 #include "comm_manipulation.hpp"
 #include "complex_comm.hpp"
 #include "context.hpp"
 #include "log.hpp"
 #include "mpi-ext.h"
+#include "resilient_call.hpp"
 
-extern std::shared_timed_mutex failure_mtx;
 using namespace legio;
 
+// Fences synchronize the alias first, as creating the window does
+using WindowFence = CallPolicy<Recovery::replace, false, true>;
+
 int MPI_Win_create(void* base,
                    MPI_Aint size,
                    int disp_unit,
@@ -18,15 +20,17 @@ int MPI_Win_create(void* base,
                    MPI_Comm comm,
                    MPI_Win* win)
 {
+    Context::get().c_manager.expose(base);
     while (1)
     {
-        int rc;
+        int rc, version = 0;
         bool flag = Context::get().m_comm.part_of(comm);
         std::function<int(MPI_Comm, MPI_Win*)> func;
         if (flag)
         {
             ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
             MPI_Barrier(translated.get_alias());
+            version = translated.get_version();
             func = [base, size, disp_unit, info](MPI_Comm c, MPI_Win* w) -> int {
                 int rc = PMPI_Win_create(base, size, disp_unit, info, c, w);
                 MPI_Win_set_errhandler(*w, MPI_ERRORS_RETURN);
@@ -47,7 +51,7 @@ int MPI_Win_create(void* base,
                 return rc;
         }
         else
-            replace_comm(Context::get().m_comm.translate_into_complex(comm));
+            replace_comm(Context::get().m_comm.translate_into_complex(comm), version);
     }
 }
 
@@ -60,13 +64,14 @@ int MPI_Win_allocate(MPI_Aint size,
 {
     while (1)
     {
-        int rc;
+        int rc, version = 0;
         std::function<int(MPI_Comm, MPI_Win*)> func;
         bool flag = Context::get().m_comm.part_of(comm);
         if (flag)
         {
             ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
             MPI_Barrier(translated.get_alias());
+            version = translated.get_version();
             func = [size, disp_unit, info, baseptr](MPI_Comm c, MPI_Win* w) -> int {
                 int rc = PMPI_Win_allocate(size, disp_unit, info, c, baseptr, w);
                 MPI_Win_set_errhandler(*w, MPI_ERRORS_RETURN);
@@ -87,7 +92,7 @@ int MPI_Win_allocate(MPI_Aint size,
                 return rc;
         }
         else
-            replace_comm(Context::get().m_comm.translate_into_complex(comm));
+            replace_comm(Context::get().m_comm.translate_into_complex(comm), version);
     }
 }
 
@@ -99,25 +104,9 @@ int MPI_Win_free(MPI_Win* win)
 
 int MPI_Win_fence(int assert, MPI_Win win)
 {
-    while (1)
-    {
-        int rc;
-        bool flag = Context::get().m_comm.part_of(win);
-        if (flag)
-        {
-            ComplexComm& comm = Context::get().m_comm.get_complex_from_structure(win);
-            MPI_Win translated = comm.translate_structure(win);
-            MPI_Barrier(comm.get_alias());
-            rc = PMPI_Win_fence(assert, translated);
-        }
-        else
-            rc = PMPI_Win_fence(assert, win);
-        legio::report_execution(rc, MPI_COMM_WORLD, "Win_fence");
-        if (rc == MPI_SUCCESS || !flag)
-            return rc;
-        else
-            replace_comm(Context::get().m_comm.get_complex_from_structure(win));
-    }
+    return resilient_call<WindowFence>("Win_fence", win, [&](MPI_Win w) {
+        return PMPI_Win_fence(assert, w);
+    });
 }
 
 int MPI_Get(void* origin_addr,
@@ -129,6 +118,7 @@ int MPI_Get(void* origin_addr,
             MPI_Datatype target_datatype,
             MPI_Win win)
 {
+    Context::get().c_manager.expose(origin_addr);
     int rc;
     bool flag = Context::get().m_comm.part_of(win);
 
@@ -139,7 +129,7 @@ int MPI_Get(void* origin_addr,
         int new_rank = translate_ranks(target_rank, comm);
         if (new_rank == MPI_UNDEFINED)
         {
-            if constexpr (BuildOptions::get_resiliency)
+            if (comm.get_policy().get_resiliency)
                 rc = MPI_SUCCESS;
             else
             {
@@ -176,7 +166,7 @@ int MPI_Put(const void* origin_addr,
         int new_rank = translate_ranks(target_rank, comm);
         if (new_rank == MPI_UNDEFINED)
         {
-            if constexpr (BuildOptions::put_resiliency)
+            if (comm.get_policy().put_resiliency)
                 rc = MPI_SUCCESS;
             else
             {
@@ -1,23 +1,43 @@
 #include <mpi.h>
 #include <signal.h>
 #include <stdio.h>
-#include <shared_mutex>
+#include <vector>
 #include "comm_manipulation.hpp"
 #include "complex_comm.hpp"
 #include "context.hpp"
 #include "log.hpp"
 #include "mpi-ext.h"
 
-extern std::shared_timed_mutex failure_mtx;
 using namespace legio;
 
 int any_recv(void*, int, MPI_Datatype, int, int, MPI_Comm, MPI_Status*);
+int split_sendrecv(const void*,
+                   int,
+                   MPI_Datatype,
+                   int,
+                   int,
+                   void*,
+                   int,
+                   MPI_Datatype,
+                   int,
+                   int,
+                   MPI_Status*);
+void count_sendrecv(int, MPI_Status*);
 
 int MPI_Send(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm)
 {
     int i, rc;
+    if constexpr (BuildOptions::replicate_critical)
+        if (comm == MPI_COMM_WORLD && Context::get().rep_manager.is_shadowing())
+        {
+            // The primary is the one actually sending, the message is kept for a promotion
+            Context::get().rep_manager.suppress(buf, count, datatype, dest, tag);
+            return MPI_SUCCESS;
+        }
     bool flag = Context::get().m_comm.part_of(comm);
-    for (i = 0; i < BuildOptions::num_retry; i++)
+    // Looked up once for all the retries
+    const ResiliencyPolicy& policy = Context::get().m_comm.get_policy(comm);
+    for (i = 0; i < policy.num_retry; i++)
     {
         if (flag)
         {
@@ -25,7 +45,7 @@ int MPI_Send(const void* buf, int count, MPI_Datatype datatype, int dest, int ta
             int dest_rank = translate_ranks(dest, translated);
             if (dest_rank == MPI_UNDEFINED)
             {
-                if constexpr (BuildOptions::send_resiliency)
+                if (policy.send_resiliency)
                     rc = MPI_SUCCESS;
                 else
                 {
@@ -34,7 +54,15 @@ int MPI_Send(const void* buf, int count, MPI_Datatype datatype, int dest, int ta
                 }
             }
             else
+            {
+                if constexpr (BuildOptions::message_logging)
+                    if (i == 0)
+                        Context::get().m_log.record(buf, count, datatype, dest, tag, translated);
+                if constexpr (BuildOptions::replicate_critical)
+                    if (i == 0 && comm == MPI_COMM_WORLD)
+                        Context::get().rep_manager.forward(buf, count, datatype, dest, tag);
                 rc = PMPI_Send(buf, count, datatype, dest_rank, tag, translated.get_comm());
+            }
         }
         else
             rc = PMPI_Send(buf, count, datatype, dest, tag, comm);
@@ -53,19 +81,23 @@ int MPI_Recv(void* buf,
              MPI_Comm comm,
              MPI_Status* status)
 {
+    Context::get().c_manager.expose(buf);
+    if constexpr (BuildOptions::replicate_critical)
+        if (comm == MPI_COMM_WORLD && Context::get().rep_manager.serves(source, tag))
+            return Context::get().rep_manager.receive(buf, count, datatype, source, tag, status);
     if (source == MPI_ANY_SOURCE)
         return any_recv(buf, count, datatype, source, tag, comm, status);
 
     int rc;
     bool flag = Context::get().m_comm.part_of(comm);
-    ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
-    failure_mtx.lock_shared();
+    Context::get().m_comm.lock_shared(comm);
     if (flag)
     {
+        ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
         int source_rank = translate_ranks(source, translated);
         if (source_rank == MPI_UNDEFINED)
         {
-            if constexpr (BuildOptions::recv_resiliency)
+            if (translated.get_policy().recv_resiliency)
                 rc = MPI_SUCCESS;
             else
             {
@@ -77,8 +109,11 @@ int MPI_Recv(void* buf,
             rc = PMPI_Recv(buf, count, datatype, source_rank, tag, translated.get_comm(), status);
     }
     else
-        rc = PMPI_Recv(buf, count, datatype, source, tag, translated.get_comm(), status);
-    failure_mtx.unlock_shared();
+        rc = PMPI_Recv(buf, count, datatype, source, tag, comm, status);
+    Context::get().m_comm.unlock_shared(comm);
+    if constexpr (BuildOptions::replicate_critical)
+        if (comm == MPI_COMM_WORLD && rc == MPI_SUCCESS)
+            Context::get().rep_manager.count_received(source);
     legio::report_execution(rc, comm, "Recv");
     return rc;
 }
@@ -96,9 +131,17 @@ int MPI_Sendrecv(const void* sendbuf,
                  MPI_Comm comm,
                  MPI_Status* status)
 {
+    Context::get().c_manager.expose(recvbuf);
+    if constexpr (BuildOptions::replicate_critical)
+        if (comm == MPI_COMM_WORLD && Context::get().rep_manager.serves(source, recvtag))
+            return split_sendrecv(sendbuf, sendcount, sendtype, dest, sendtag, recvbuf, recvcount,
+                                  recvtype, source, recvtag, status);
     int rc;
+    MPI_Status own_status;
+    if (status == MPI_STATUS_IGNORE)
+        status = &own_status;
     bool flag = Context::get().m_comm.part_of(comm);
-    failure_mtx.lock_shared();
+    Context::get().m_comm.lock_shared(comm);
     if (flag)
     {
         ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
@@ -106,7 +149,7 @@ int MPI_Sendrecv(const void* sendbuf,
         int dest_rank = translate_ranks(dest, translated);
         if (source_rank == MPI_UNDEFINED)
         {
-            if constexpr (BuildOptions::recv_resiliency && BuildOptions::send_resiliency)
+            if (translated.get_policy().recv_resiliency && translated.get_policy().send_resiliency)
                 rc = MPI_SUCCESS;
             else
             {
@@ -115,13 +158,21 @@ int MPI_Sendrecv(const void* sendbuf,
             }
         }
         else
+        {
+            if constexpr (BuildOptions::replicate_critical)
+                if (comm == MPI_COMM_WORLD)
+                    Context::get().rep_manager.forward(sendbuf, sendcount, sendtype, dest, sendtag);
             rc = PMPI_Sendrecv(sendbuf, sendcount, sendtype, dest_rank, sendtag, recvbuf, recvcount,
                                recvtype, source_rank, recvtag, translated.get_comm(), status);
+        }
     }
     else
         rc = PMPI_Sendrecv(sendbuf, sendcount, sendtype, dest, sendtag, recvbuf, recvcount,
                            recvtype, source, recvtag, comm, status);
-    failure_mtx.unlock_shared();
+    Context::get().m_comm.unlock_shared(comm);
+    if constexpr (BuildOptions::replicate_critical)
+        if (comm == MPI_COMM_WORLD && rc == MPI_SUCCESS)
+            count_sendrecv(source, status);
     legio::report_execution(rc, comm, "Sendrecv");
     return rc;
 }
@@ -136,9 +187,24 @@ int MPI_Sendrecv_replace(void* sendbuf,
                          MPI_Comm comm,
                          MPI_Status* status)
 {
+    Context::get().c_manager.expose(sendbuf);
+    if constexpr (BuildOptions::replicate_critical)
+        if (comm == MPI_COMM_WORLD && Context::get().rep_manager.serves(source, recvtag))
+        {
+            // The receive overwrites the buffer, the send goes out from a packed copy
+            int size, position = 0;
+            PMPI_Pack_size(count, datatype, comm, &size);
+            std::vector<char> packed(size);
+            PMPI_Pack(sendbuf, count, datatype, packed.data(), size, &position, comm);
+            return split_sendrecv(packed.data(), position, MPI_PACKED, dest, sendtag, sendbuf,
+                                  count, datatype, source, recvtag, status);
+        }
     int rc;
+    MPI_Status own_status;
+    if (status == MPI_STATUS_IGNORE)
+        status = &own_status;
     bool flag = Context::get().m_comm.part_of(comm);
-    failure_mtx.lock_shared();
+    Context::get().m_comm.lock_shared(comm);
     if (flag)
     {
         ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
@@ -146,7 +212,7 @@ int MPI_Sendrecv_replace(void* sendbuf,
         int dest_rank = translate_ranks(dest, translated);
         if (source_rank == MPI_UNDEFINED)
         {
-            if constexpr (BuildOptions::recv_resiliency && BuildOptions::send_resiliency)
+            if (translated.get_policy().recv_resiliency && translated.get_policy().send_resiliency)
                 rc = MPI_SUCCESS;
             else
             {
@@ -155,17 +221,55 @@ int MPI_Sendrecv_replace(void* sendbuf,
             }
         }
         else
+        {
+            if constexpr (BuildOptions::replicate_critical)
+                if (comm == MPI_COMM_WORLD)
+                    Context::get().rep_manager.forward(sendbuf, count, datatype, dest, sendtag);
             rc = PMPI_Sendrecv_replace(sendbuf, count, datatype, dest_rank, sendtag, source_rank,
                                        recvtag, translated.get_comm(), status);
+        }
     }
     else
         rc = PMPI_Sendrecv_replace(sendbuf, count, datatype, dest, sendtag, source, recvtag, comm,
                                    status);
-    failure_mtx.unlock_shared();
+    Context::get().m_comm.unlock_shared(comm);
+    if constexpr (BuildOptions::replicate_critical)
+        if (comm == MPI_COMM_WORLD && rc == MPI_SUCCESS)
+            count_sendrecv(source, status);
     legio::report_execution(rc, comm, "Sendrecv");
     return rc;
 }
 
+// A Sendrecv on MPI_COMM_WORLD served by the primaries: the send is started first, so that two
+// ranks exchanging this way never wait for each other
+int split_sendrecv(const void* sendbuf,
+                   int sendcount,
+                   MPI_Datatype sendtype,
+                   int dest,
+                   int sendtag,
+                   void* recvbuf,
+                   int recvcount,
+                   MPI_Datatype recvtype,
+                   int source,
+                   int recvtag,
+                   MPI_Status* status)
+{
+    MPI_Request request;
+    int rc = MPI_Isend(sendbuf, sendcount, sendtype, dest, sendtag, MPI_COMM_WORLD, &request);
+    if (rc != MPI_SUCCESS)
+        return rc;
+    rc = MPI_Recv(recvbuf, recvcount, recvtype, source, recvtag, MPI_COMM_WORLD, status);
+    int send_rc = MPI_Wait(&request, MPI_STATUS_IGNORE);
+    return rc != MPI_SUCCESS ? rc : send_rc;
+}
+
+void count_sendrecv(int source, MPI_Status* status)
+{
+    if (source == MPI_ANY_SOURCE)
+        source = Context::get().r_manager.untranslate_world_rank(status->MPI_SOURCE);
+    Context::get().rep_manager.count_received(source);
+}
+
 int any_recv(void* buf,
              int count,
              MPI_Datatype datatype,
@@ -175,6 +279,9 @@ int any_recv(void* buf,
              MPI_Status* status)
 {
     int rc;
+    MPI_Status own_status;
+    if (status == MPI_STATUS_IGNORE)
+        status = &own_status;
     bool flag = Context::get().m_comm.part_of(comm);
     if (flag)
     {
@@ -184,7 +291,11 @@ int any_recv(void* buf,
     else
         rc = PMPI_Recv(buf, count, datatype, source, tag, comm, status);
     legio::report_execution(rc, comm, "Recv");
-    if (rc != MPI_SUCCESS)
+    if constexpr (BuildOptions::replicate_critical)
+        if (comm == MPI_COMM_WORLD && rc == MPI_SUCCESS)
+            Context::get().rep_manager.count_received(
+                Context::get().r_manager.untranslate_world_rank(status->MPI_SOURCE));
+    if (rc != MPI_SUCCESS && flag)
     {
         /*
         int eclass;
@@ -195,7 +306,8 @@ int any_recv(void* buf,
         }
         */
 
-        MPIX_Comm_failure_ack(Context::get().m_comm.translate_into_complex(comm).get_comm());
+        ComplexComm& translated = Context::get().m_comm.translate_into_complex(comm);
+        MPIX_Comm_failure_ack(translated.get_comm());
     }
     return rc;
 }
\ No newline at end of file
@@ -0,0 +1,648 @@
+#include "replica_manager.hpp"
+#include <signal.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <numeric>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "complex_comm.hpp"
+#include "context.hpp"
+#include "log.hpp"
+#include "mpi.h"
+#include "restart_routines.hpp"
+
+#include "mpi-ext.h"
+
+extern "C" {
+#include "legio.h"
+}
+
+extern std::mutex repair_mtx;
+using namespace legio;
+
+int ReplicaManager::Link::remote_of(const int world_rank) const
+{
+    if (world_rank == MPI_ANY_SOURCE)
+        return MPI_ANY_SOURCE;
+    auto found = std::lower_bound(primaries.begin(), primaries.end(), world_rank);
+    if (found == primaries.end() || *found != world_rank)
+        return MPI_UNDEFINED;
+    return found - primaries.begin();
+}
+
+void ReplicaManager::spawn(int argc, char** argv)
+{
+    const auto& critical = Context::get().r_manager.get_respawn_list();
+    if (critical.empty())
+        return;
+    // Replicas run the same program, the i-th one shadowing critical[i]
+    std::vector<char*> replica_argv(argv + 1, argv + argc);
+    replica_argv.push_back(const_cast<char*>("--replica"));
+    replica_argv.push_back(NULL);
+    ComplexComm& world = Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD);
+    int rc = PMPI_Comm_spawn(program_invocation_name, replica_argv.data(), critical.size(),
+                             MPI_INFO_NULL, 0, world.get_comm(), &data, MPI_ERRCODES_IGNORE);
+    if (rc != MPI_SUCCESS)
+    {
+        legio::log("Unable to spawn the replicas, respawn will be used", LogLevel::errors_only);
+        data = MPI_COMM_NULL;
+        return;
+    }
+    MPI_Comm_set_errhandler(data, MPI_ERRORS_RETURN);
+
+    std::vector<int> message = encode_bootstrap_message(
+        LEGIO_REPLICA_PROMOTE_VALUE, critical, {}, Context::get().r_manager.get_world_size());
+    int rank, length = message.size();
+    PMPI_Comm_rank(world.get_comm(), &rank);
+    int root = rank == 0 ? MPI_ROOT : MPI_PROC_NULL;
+    PMPI_Bcast(&length, 1, MPI_INT, root, data);
+    PMPI_Bcast(message.data(), length, MPI_INT, root, data);
+    PMPI_Comm_dup(data, &control);
+    MPI_Comm_set_errhandler(control, MPI_ERRORS_RETURN);
+    shadowed = critical;
+}
+
+void ReplicaManager::attach()
+{
+    int own, length;
+    PMPI_Comm_get_parent(&data);
+    MPI_Comm_set_errhandler(data, MPI_ERRORS_RETURN);
+    PMPI_Comm_rank(data, &own);
+    PMPI_Bcast(&length, 1, MPI_INT, 0, data);
+    std::vector<int> message(length);
+    PMPI_Bcast(message.data(), length, MPI_INT, 0, data);
+    PMPI_Comm_dup(data, &control);
+    MPI_Comm_set_errhandler(control, MPI_ERRORS_RETURN);
+
+    BootstrapState state = decode_bootstrap_message(message);
+    Context::get().c_manager.set_job_key(state.job_key);
+    Context::get().r_manager.initialize(state.world_size, state.to_fill[own], state.failed);
+    for (auto critical : state.respawn_list)
+        Context::get().r_manager.add_to_respawn_list(critical);
+    shadowed = state.to_fill;
+    primaries.resize(state.world_size);
+    std::iota(primaries.begin(), primaries.end(), 0);
+    replica = true;
+    shadowing = true;
+
+    std::thread promotion(&ReplicaManager::listen, this);
+    promotion.detach();
+}
+
+bool ReplicaManager::serves(const int source, const int tag)
+{
+    if (shadowing)
+        return true;
+    return pending_link(source, tag).comm != MPI_COMM_NULL;
+}
+
+void ReplicaManager::complete_forwards()
+{
+    for (auto it = forwarding.begin(); it != forwarding.end();)
+    {
+        int flag = 0;
+        int rc = PMPI_Test(&(it->request), &flag, MPI_STATUS_IGNORE);
+        if (rc != MPI_SUCCESS && it->replica >= 0)
+            lose_replica(it->replica);
+        if (flag || rc != MPI_SUCCESS)
+            it = forwarding.erase(it);
+        else
+            it++;
+    }
+}
+
+// Called with the lock held: the replica gets no more copies, and its primary is respawned if it
+// fails
+void ReplicaManager::lose_replica(const int index)
+{
+    if (shadowed[index] == MPI_UNDEFINED)
+        return;
+    legio::log("Replica failed, its primary will be respawned", LogLevel::errors_only);
+    shadowed[index] = MPI_UNDEFINED;
+}
+
+void ReplicaManager::forward(const void* buf, int count, MPI_Datatype datatype, int dest, int tag)
+{
+    const std::lock_guard<std::mutex> guard(lock);
+    if (data == MPI_COMM_NULL)
+        return;
+    auto found = std::find(shadowed.begin(), shadowed.end(), dest);
+    if (found == shadowed.end())
+        return;
+    complete_forwards();
+    int size, position = 0;
+    const int replica = found - shadowed.begin();
+    PMPI_Pack_size(count, datatype, data, &size);
+    forwarding.push_back({MPI_REQUEST_NULL, std::vector<char>(size), replica});
+    auto& packed = forwarding.back().packed;
+    PMPI_Pack(buf, count, datatype, packed.data(), size, &position, data);
+    // Sent from a copy, the caller may reuse its buffer as soon as its own send completes
+    if (PMPI_Isend(packed.data(), position, MPI_PACKED, replica, tag, data,
+                   &(forwarding.back().request)) != MPI_SUCCESS)
+    {
+        forwarding.pop_back();
+        lose_replica(replica);
+    }
+}
+
+void ReplicaManager::count_received(const int world_rank)
+{
+    const std::lock_guard<std::mutex> guard(lock);
+    if (std::find(shadowed.begin(), shadowed.end(), world_rank) != shadowed.end())
+        received[world_rank]++;
+}
+
+void ReplicaManager::track_receive(MPI_Request request, const std::vector<int>& primaries)
+{
+    const std::lock_guard<std::mutex> guard(lock);
+    tracked_receives[request] = primaries;
+}
+
+void ReplicaManager::complete_receive(MPI_Request request, MPI_Status* status)
+{
+    std::vector<int> sources;
+    {
+        const std::lock_guard<std::mutex> guard(lock);
+        auto found = tracked_receives.find(request);
+        if (found == tracked_receives.end())
+            return;
+        sources.swap(found->second);
+        tracked_receives.erase(found);
+    }
+    int cancelled;
+    PMPI_Test_cancelled(status, &cancelled);
+    if (cancelled)
+        return;
+    if (sources.empty())
+    {
+        count_received(Context::get().r_manager.untranslate_world_rank(status->MPI_SOURCE));
+        return;
+    }
+    status->MPI_SOURCE = sources[status->MPI_SOURCE];
+    count_received(status->MPI_SOURCE);
+}
+
+void ReplicaManager::refuse_collective(MPI_Comm alias, const char* name)
+{
+    if (!shadowing || alias == MPI_COMM_SELF)
+        return;
+    const std::string message =
+        "##### " + std::string(name) + " called by a shadowing replica, stopping it";
+    legio::log(message.c_str(), LogLevel::errors_only);
+    raise(SIGINT);
+}
+
+void ReplicaManager::suppress(const void* buf,
+                              int count,
+                              MPI_Datatype datatype,
+                              int dest,
+                              int tag)
+{
+    Entry entry = {tag};
+    int size, position = 0;
+    PMPI_Pack_size(count, datatype, MPI_COMM_SELF, &size);
+    entry.packed.resize(size);
+    PMPI_Pack(buf, count, datatype, entry.packed.data(), size, &position, MPI_COMM_SELF);
+    entry.packed.resize(position);
+
+    const std::lock_guard<std::mutex> guard(lock);
+    auto& peer = held_back[dest];
+    auto& bytes = held_bytes[dest];
+    bytes += entry.packed.size();
+    peer.second.push_back(std::move(entry));
+    // Bounded like the message log, the oldest messages cannot be resent after a promotion
+    if constexpr (BuildOptions::message_log_size > 0)
+        while (bytes > BuildOptions::message_log_size && !peer.second.empty())
+        {
+            bytes -= peer.second.front().packed.size();
+            peer.second.pop_front();
+            peer.first++;
+            legio::log("Replica send log full, oldest message dropped", LogLevel::errors_only);
+        }
+}
+
+void ReplicaManager::exit_if_released()
+{
+    if (released)
+    {
+        stop_repair_listener();
+        PMPI_Finalize();
+        exit(0);
+    }
+}
+
+// A drain holding a message that matches, otherwise the link of a shadowing replica; a null
+// comm means that the receive goes through the world
+ReplicaManager::Link ReplicaManager::pending_link(const int source, const int tag)
+{
+    const std::lock_guard<std::mutex> guard(lock);
+    for (const auto& drain : drains)
+    {
+        int remote = drain.remote_of(source), flag = 0;
+        if (remote == MPI_UNDEFINED)
+            continue;
+        if (PMPI_Iprobe(remote, tag, drain.comm, &flag, MPI_STATUS_IGNORE) == MPI_SUCCESS && flag)
+            return drain;
+    }
+    if (shadowing)
+        return {data, primaries, true};
+    return {MPI_COMM_NULL, {}, false};
+}
+
+int ReplicaManager::receive(void* buf,
+                            int count,
+                            MPI_Datatype datatype,
+                            int source,
+                            int tag,
+                            MPI_Status* status)
+{
+    while (1)
+    {
+        Link link = pending_link(source, tag);
+        if (link.comm == MPI_COMM_NULL)
+            return MPI_Recv(buf, count, datatype, source, tag, MPI_COMM_WORLD, status);
+        const int remote = link.remote_of(source);
+        if (remote == MPI_UNDEFINED)
+            return MPIX_ERR_PROC_FAILED;
+
+        MPI_Request request;
+        MPI_Status local_status;
+        int flag = 0, rc = PMPI_Irecv(buf, count, datatype, remote, tag, link.comm, &request);
+        while (rc == MPI_SUCCESS && !flag)
+        {
+            rc = PMPI_Test(&request, &flag, &local_status);
+            if (rc != MPI_SUCCESS)
+            {
+                int eclass;
+                MPI_Error_class(rc, &eclass);
+                if (eclass != MPIX_ERR_PROC_FAILED_PENDING)
+                    break;
+                // A primary failed, the others can still match an any-source receive
+                MPIX_Comm_failure_ack(link.comm);
+                rc = MPI_SUCCESS;
+            }
+            if (flag)
+                break;
+            bool replaced = false;
+            if (link.current)
+            {
+                const std::lock_guard<std::mutex> guard(lock);
+                replaced = data != link.comm;
+            }
+            if (replaced)
+            {
+                // Promoted or re-connected meanwhile: look again where the message can come from
+                int cancelled;
+                PMPI_Cancel(&request);
+                PMPI_Wait(&request, &local_status);
+                PMPI_Test_cancelled(&local_status, &cancelled);
+                if (cancelled)
+                    break;
+                flag = 1;
+                break;
+            }
+            exit_if_released();
+            std::this_thread::yield();
+        }
+        if (rc != MPI_SUCCESS)
+            return rc;
+        if (!flag)
+            continue;
+
+        const int world_source = link.primaries[local_status.MPI_SOURCE];
+        count_received(world_source);
+        if (status != MPI_STATUS_IGNORE)
+        {
+            *status = local_status;
+            status->MPI_SOURCE = world_source;
+        }
+        return MPI_SUCCESS;
+    }
+}
+
+int ReplicaManager::ireceive(void* buf,
+                             int count,
+                             MPI_Datatype datatype,
+                             int source,
+                             int tag,
+                             MPI_Request* request)
+{
+    Link link = pending_link(source, tag);
+    const int remote = link.remote_of(source);
+    if (link.comm == MPI_COMM_NULL || remote == MPI_UNDEFINED)
+        return MPIX_ERR_PROC_FAILED;
+    int rc = PMPI_Irecv(buf, count, datatype, remote, tag, link.comm, request);
+    if (rc == MPI_SUCCESS)
+        track_receive(*request, link.primaries);
+    return rc;
+}
+
+void ReplicaManager::send_to_replicas(const std::vector<int>& message, MPI_Comm world_comm)
+{
+    int rank, replicas;
+    PMPI_Comm_rank(world_comm, &rank);
+    PMPI_Comm_remote_size(control, &replicas);
+    if (rank == 0)
+        for (int i = 0; i < replicas; i++)
+            if (shadowed[i] != MPI_UNDEFINED)
+                PMPI_Send(message.data(), message.size(), MPI_INT, i, LEGIO_REPLICA_TAG, control);
+}
+
+// The failed replicas are left out of the new intercomm as well
+void ReplicaManager::drop_promoted(const std::vector<int>& promoted)
+{
+    for (auto world_rank : promoted)
+        shadowed.erase(std::remove(shadowed.begin(), shadowed.end(), world_rank),
+                       shadowed.end());
+    shadowed.erase(std::remove(shadowed.begin(), shadowed.end(), MPI_UNDEFINED), shadowed.end());
+}
+
+// Replicas missing from shrunk are lost, false if one of them had to fill a rank; both sides of
+// control see the same survivors and take the same decision
+bool ReplicaManager::keep_surviving(MPI_Comm shrunk, const std::vector<int>& to_fill)
+{
+    MPI_Group before, after;
+    if (shadowing)
+    {
+        PMPI_Comm_group(control, &before);
+        PMPI_Comm_group(shrunk, &after);
+    }
+    else
+    {
+        PMPI_Comm_remote_group(control, &before);
+        PMPI_Comm_remote_group(shrunk, &after);
+    }
+    const std::lock_guard<std::mutex> guard(lock);
+    std::vector<int> ranks(shadowed.size()), translated(shadowed.size());
+    std::iota(ranks.begin(), ranks.end(), 0);
+    PMPI_Group_translate_ranks(before, ranks.size(), ranks.data(), after, translated.data());
+    PMPI_Group_free(&before);
+    PMPI_Group_free(&after);
+    for (std::size_t i = 0; i < shadowed.size(); i++)
+        if (translated[i] == MPI_UNDEFINED)
+            lose_replica(i);
+    for (auto world_rank : to_fill)
+        if (std::find(shadowed.begin(), shadowed.end(), world_rank) == shadowed.end())
+            return false;
+    return true;
+}
+
+// Collective over merged: the new world and the replicas left are joined by a new intercomm,
+// null if no replica is left
+MPI_Comm ReplicaManager::reconnect(MPI_Comm merged, MPI_Comm new_comm, const bool in_world)
+{
+    int merged_rank, leader;
+    PMPI_Comm_rank(merged, &merged_rank);
+    int candidate = in_world ? INT_MAX : merged_rank;
+    PMPI_Allreduce(&candidate, &leader, 1, MPI_INT, MPI_MIN, merged);
+    if (leader == INT_MAX)
+        return MPI_COMM_NULL;
+
+    // Survivors are first in merged, so its rank 0 leads the world side
+    MPI_Comm new_data;
+    if (in_world)
+    {
+        MPI_Group merged_group, world_group;
+        int zero = 0, local_leader;
+        PMPI_Comm_group(merged, &merged_group);
+        PMPI_Comm_group(new_comm, &world_group);
+        PMPI_Group_translate_ranks(merged_group, 1, &zero, world_group, &local_leader);
+        PMPI_Group_free(&merged_group);
+        PMPI_Group_free(&world_group);
+        PMPI_Intercomm_create(new_comm, local_leader, merged, leader, LEGIO_REPLICA_TAG,
+                              &new_data);
+    }
+    else
+        PMPI_Intercomm_create(new_comm, 0, merged, 0, LEGIO_REPLICA_TAG, &new_data);
+    MPI_Comm_set_errhandler(new_data, MPI_ERRORS_RETURN);
+    return new_data;
+}
+
+bool ReplicaManager::promote(MPI_Comm tmp_world,
+                             const int key,
+                             const std::vector<int>& to_respawn,
+                             const std::vector<int>& failed,
+                             const int world_size,
+                             MPI_Comm* new_world)
+{
+    if (control == MPI_COMM_NULL)
+        return false;
+    for (auto world_rank : to_respawn)
+        if (std::find(shadowed.begin(), shadowed.end(), world_rank) == shadowed.end())
+        {
+            // A failed critical rank has no replica, release them all and respawn from now on
+            send_to_replicas({LEGIO_REPLICA_RELEASE_VALUE}, tmp_world);
+            const std::lock_guard<std::mutex> guard(lock);
+            shadowed.clear();
+            PMPI_Comm_free(&control);
+            PMPI_Comm_free(&data);
+            return false;
+        }
+
+    std::vector<int> message = encode_bootstrap_message(LEGIO_REPLICA_PROMOTE_VALUE, to_respawn,
+                                                        failed, world_size);
+    send_to_replicas(message, tmp_world);
+
+    MPI_Comm shrunk, merged;
+    MPIX_Comm_shrink(control, &shrunk);
+    if (!keep_surviving(shrunk, to_respawn))
+    {
+        // A replica to promote failed meanwhile: the others are released and the ranks respawned
+        PMPI_Comm_free(&shrunk);
+        const std::lock_guard<std::mutex> guard(lock);
+        shadowed.clear();
+        PMPI_Comm_free(&control);
+        PMPI_Comm_free(&data);
+        return false;
+    }
+    PMPI_Intercomm_merge(shrunk, 0, &merged);
+    PMPI_Comm_split(merged, 1, key, new_world);
+    MPI_Comm new_data = reconnect(merged, *new_world, true);
+    PMPI_Comm_free(&shrunk);
+    PMPI_Comm_free(&merged);
+    PMPI_Comm_free(&tmp_world);
+
+    const std::lock_guard<std::mutex> guard(lock);
+    PMPI_Comm_free(&control);
+    PMPI_Comm_free(&data);
+    data = new_data;
+    if (data != MPI_COMM_NULL)
+    {
+        PMPI_Comm_dup(data, &control);
+        MPI_Comm_set_errhandler(control, MPI_ERRORS_RETURN);
+    }
+    drop_promoted(to_respawn);
+    return true;
+}
+
+void ReplicaManager::resume(const std::vector<int>& promoted)
+{
+    ComplexComm& world = Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD);
+    int own;
+    MPI_Comm_rank(MPI_COMM_WORLD, &own);
+    std::map<int, int> delivered;
+    {
+        const std::lock_guard<std::mutex> guard(lock);
+        for (auto world_rank : promoted)
+            if (world_rank != own)
+            {
+                int count = received[world_rank];
+                PMPI_Send(&count, 1, MPI_INT,
+                          Context::get().r_manager.translate_ranks(world_rank, world),
+                          LEGIO_REPLICA_TAG, world.get_comm());
+            }
+        for (auto world_rank : promoted)
+            received.erase(world_rank);
+    }
+    if (std::find(promoted.begin(), promoted.end(), own) == promoted.end())
+        return;
+
+    // How many of the messages of the failed primary each rank received
+    const PrefixRankBitset& failed = Context::get().r_manager.get_failed_ranks();
+    for (int world_rank = 0; world_rank < failed.size(); world_rank++)
+        if (!failed.test(world_rank) && world_rank != own)
+            PMPI_Recv(&delivered[world_rank], 1, MPI_INT,
+                      Context::get().r_manager.translate_ranks(world_rank, world),
+                      LEGIO_REPLICA_TAG, world.get_comm(), MPI_STATUS_IGNORE);
+
+    const std::lock_guard<std::mutex> guard(lock);
+    for (auto& peer : held_back)
+    {
+        auto count = delivered.find(peer.first);
+        if (count == delivered.end())
+            continue;
+        int sequence = peer.second.first;
+        for (auto& entry : peer.second.second)
+        {
+            if (sequence++ < count->second)
+                continue;
+            forwarding.push_back({MPI_REQUEST_NULL, std::move(entry.packed), -1});
+            PMPI_Isend(forwarding.back().packed.data(), forwarding.back().packed.size(),
+                       MPI_PACKED, Context::get().r_manager.translate_ranks(peer.first, world),
+                       entry.tag, world.get_comm(), &(forwarding.back().request));
+        }
+    }
+    held_back.clear();
+    held_bytes.clear();
+}
+
+// Replica side of a promotion, mirrors promote and the regeneration of the survivors
+void ReplicaManager::promote_self(const std::vector<int>& message)
+{
+    BootstrapState state = decode_bootstrap_message(message);
+    const int own_rank = Context::get().r_manager.get_own_rank();
+    for (auto world_rank : state.failed)
+        Context::get().r_manager.set_failed_rank(world_rank);
+
+    MPI_Comm shrunk, merged, new_comm;
+    int own;
+    MPIX_Comm_shrink(control, &shrunk);
+    if (!keep_surviving(shrunk, state.to_fill))
+    {
+        // The primaries give up the promotion as well and respawn the failed ranks
+        PMPI_Comm_free(&shrunk);
+        const std::lock_guard<std::mutex> guard(lock);
+        PMPI_Comm_free(&control);
+        released = true;
+        return;
+    }
+    PMPI_Comm_rank(shrunk, &own);
+    PMPI_Intercomm_merge(shrunk, 1, &merged);
+    const bool selected =
+        std::find(state.to_fill.begin(), state.to_fill.end(), own_rank) != state.to_fill.end();
+    PMPI_Comm_split(merged, selected ? 1 : 2, selected ? own_rank : own, &new_comm);
+    MPI_Comm new_data = reconnect(merged, new_comm, selected);
+    PMPI_Comm_free(&shrunk);
+    PMPI_Comm_free(&merged);
+
+    // Both the promoted and the remaining replicas see the new world as remote group
+    std::vector<int> new_primaries;
+    for (int world_rank = 0; world_rank < state.world_size; world_rank++)
+        if (!Context::get().r_manager.get_failed_ranks().test(world_rank))
+            new_primaries.push_back(world_rank);
+
+    if (selected)
+    {
+        const std::lock_guard<std::mutex> serialized(repair_mtx);
+        ComplexComm& world = Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD);
+        const std::lock_guard<ComplexComm> guard(world);
+        MPI_Comm_set_errhandler(new_comm, MPI_ERRORS_RETURN);
+        world.replace_comm(new_comm);
+        regenerate_supported_comms(own_rank, state.to_fill);
+        resume(state.to_fill);
+    }
+    else
+        PMPI_Comm_free(&new_comm);
+
+    const std::lock_guard<std::mutex> guard(lock);
+    PMPI_Comm_free(&control);
+    drains.push_back({data, primaries, false});
+    drop_promoted(state.to_fill);
+    for (auto world_rank : state.to_fill)
+        received.erase(world_rank);
+    if (selected)
+    {
+        // From now on a primary, forwarding to the replicas left
+        primaries.clear();
+        data = new_data;
+        shadowing = false;
+    }
+    else
+    {
+        primaries = new_primaries;
+        data = new_data;
+    }
+    if (data != MPI_COMM_NULL)
+    {
+        PMPI_Comm_dup(data, &control);
+        MPI_Comm_set_errhandler(control, MPI_ERRORS_RETURN);
+    }
+    else
+        control = MPI_COMM_NULL;
+}
+
+void ReplicaManager::listen()
+{
+    while (control != MPI_COMM_NULL)
+    {
+        MPI_Status status;
+        int count;
+        int rc = PMPI_Probe(MPI_ANY_SOURCE, LEGIO_REPLICA_TAG, control, &status);
+        if (rc != MPI_SUCCESS)
+        {
+            // A primary failed, the promotion request comes from the survivors
+            MPIX_Comm_failure_ack(control);
+            continue;
+        }
+        PMPI_Get_count(&status, MPI_INT, &count);
+        std::vector<int> message(count);
+        PMPI_Recv(message.data(), count, MPI_INT, status.MPI_SOURCE, LEGIO_REPLICA_TAG, control,
+                  MPI_STATUS_IGNORE);
+        if (message[0] == LEGIO_REPLICA_RELEASE_VALUE)
+        {
+            released = true;
+            return;
+        }
+        promote_self(message);
+        if (!shadowing || released)
+            return;
+    }
+}
+
+void ReplicaManager::release()
+{
+    if (control == MPI_COMM_NULL || (replica && shadowing))
+        return;
+    ComplexComm& world = Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD);
+    send_to_replicas({LEGIO_REPLICA_RELEASE_VALUE}, world.get_comm());
+}
+
+bool ReplicaManager::wait_release()
+{
+    while (shadowing && !released)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return released;
+}
@@ -0,0 +1,60 @@
+#include "resiliency_policy.hpp"
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "log.hpp"
+#include "mpi.h"
+
+using namespace legio;
+
+static bool read_key(MPI_Info info, const char* key, std::string* value)
+{
+    int length, flag;
+    PMPI_Info_get_valuelen(info, key, &length, &flag);
+    if (!flag)
+        return false;
+    std::vector<char> buffer(length + 1);
+    PMPI_Info_get(info, key, length, buffer.data(), &flag);
+    value->assign(buffer.data());
+    return true;
+}
+
+static void read_flag(MPI_Info info, const char* key, bool* field)
+{
+    std::string value;
+    if (!read_key(info, key, &value))
+        return;
+    if (value == "true")
+        *field = true;
+    else if (value == "false")
+        *field = false;
+    else
+        legio::log("Ignoring Legio hint with a value other than true/false", LogLevel::errors_only);
+}
+
+void ResiliencyPolicy::update(MPI_Info info)
+{
+    if (info == MPI_INFO_NULL)
+        return;
+    read_flag(info, "legio_broadcast_resiliency", &broadcast_resiliency);
+    read_flag(info, "legio_send_resiliency", &send_resiliency);
+    read_flag(info, "legio_recv_resiliency", &recv_resiliency);
+    read_flag(info, "legio_reduce_resiliency", &reduce_resiliency);
+    read_flag(info, "legio_get_resiliency", &get_resiliency);
+    read_flag(info, "legio_put_resiliency", &put_resiliency);
+    read_flag(info, "legio_gather_resiliency", &gather_resiliency);
+    read_flag(info, "legio_gather_shift", &gather_shift);
+    read_flag(info, "legio_scatter_resiliency", &scatter_resiliency);
+    read_flag(info, "legio_scatter_shift", &scatter_shift);
+    read_flag(info, "legio_unmanaged", &unmanaged);
+    std::string value;
+    if (read_key(info, "legio_num_retry", &value))
+    {
+        int retries = std::atoi(value.c_str());
+        if (retries > 0)
+            num_retry = retries;
+        else
+            legio::log("Ignoring legio_num_retry, it must be strictly positive",
+                       LogLevel::errors_only);
+    }
+}
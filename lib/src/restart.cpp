@@ -16,6 +16,7 @@
 #include "context.hpp"
 #include "mpi-ext.h"
 #include "mpi.h"
+#include "restart_routines.hpp"
 //#include "respawn_multicomm.hpp"
 #include "supported_comm.hpp"
 extern "C" {
@@ -41,13 +42,9 @@ void initialize_comm(const int n, const int* ranks, MPI_Comm* newcomm)
         int rank, found = false;
         if (!Context::get().r_manager.is_respawned())
         {
-            std::vector<Rank> world_ranks;
+            std::vector<int> world_ranks(ranks, ranks + n);
             PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
             PMPI_Comm_group(MPI_COMM_WORLD, &group_world);
-            for (int i = 0; i < n; i++)
-            {
-                world_ranks.push_back(Rank(ranks[i], false));
-            }
             PMPI_Group_incl(group_world, n, ranks, &new_group);
             MPI_Comm_create(MPI_COMM_WORLD, new_group, newcomm);
             if (*newcomm != MPI_COMM_NULL)
@@ -58,83 +55,49 @@ void initialize_comm(const int n, const int* ranks, MPI_Comm* newcomm)
                      Context::get().r_manager.supported_comms_vector.size()});
             }
 
-            SupportedComm* supported_comm = new SupportedComm(*newcomm, world_ranks);
-            Context::get().r_manager.supported_comms_vector.push_back(*supported_comm);
+            Context::get().r_manager.supported_comms_vector.emplace_back(*newcomm, world_ranks);
         }
         else
         {
-            std::vector<Rank> world_ranks;
-            int size;
-            MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-            MPI_Comm_size(MPI_COMM_WORLD, &size);
-            ComplexComm& world_complex =
-                Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD);
-            MPI_Comm world = world_complex.get_comm();
-            // RespawnMulticomm* respawned_comms = dynamic_cast<RespawnMulticomm*>(cur_comms);
-
-            // Get the group of current world ranks
-            std::vector<int> ranks_in_comm, ranks_in_comm_translated;
-            MPI_Group new_group;
-            MPI_Comm new_comm;
+            std::vector<int> world_ranks(ranks, ranks + n), alive_ranks;
+            const PrefixRankBitset& failed_ranks = Context::get().r_manager.get_failed_ranks();
             for (int i = 0; i < n; i++)
-            {
-                if (!Context::get().r_manager.get_ranks().at(ranks[i]).failed)
-                {
-                    ranks_in_comm.push_back(i);
-                    world_ranks.push_back(Rank(ranks[i], false));
-                }
-                else
-                {
-                    world_ranks.push_back(Rank(ranks[i], true));
-                }
-            }
-
-            ComplexComm& complex = Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD);
-            // Translate the ranks according to current world
-            int dest = 0;
-            for (auto rank : ranks_in_comm)
-            {
-                /*
-                printf("Pushing comm %d\n\n", rank);
-                */
-                dest = Context::get().r_manager.translate_ranks(rank, complex);
-                ranks_in_comm_translated.push_back(dest);
-            }
-
-            MPI_Comm_group(complex.get_comm(), &group_world);
-            PMPI_Group_incl(group_world, ranks_in_comm_translated.size(),
-                            ranks_in_comm_translated.data(), &new_group);
-            /*
-            printf("Rank %d is re-creating the comm\n", rank);
-            */
-            PMPI_Comm_create(complex.get_comm(), new_group, &new_comm);
+                if (!failed_ranks.test(ranks[i]))
+                    alive_ranks.push_back(ranks[i]);
 
-            MPI_Comm_set_errhandler(new_comm, MPI_ERRORS_RETURN);
-            Context::get().m_comm.add_comm(new_comm);
-            /*
-            if (VERBOSE)
+            // Mirror the regeneration of the survivors, that identify the comm by its index
+            const int index = Context::get().r_manager.supported_comms_vector.size();
+            rank = Context::get().r_manager.get_own_rank();
+            if (std::find(alive_ranks.begin(), alive_ranks.end(), rank) != alive_ranks.end())
             {
-                int rank, size;
-                PMPI_Comm_size(new_comm, &size);
-                PMPI_Comm_rank(new_comm, &rank);
-                printf("Rank %d / %d: completed group restoration.\n", rank, size);
-                fflush(stdout);
+                found = true;
+                // A shadowing replica is not in the world yet, it gets the comm when promoted
+                if (Context::get().rep_manager.is_shadowing())
+                    PMPI_Comm_dup(MPI_COMM_SELF, newcomm);
+                else
+                    *newcomm = create_supported_comm(alive_ranks, index);
+                Context::get().m_comm.add_comm(*newcomm);
             }
-            */
-            *newcomm = new_comm;
+            else
+                *newcomm = MPI_COMM_NULL;
 
-            SupportedComm* supported_comm = new SupportedComm(*newcomm, world_ranks);
-            Context::get().r_manager.add_to_supported_comms(
-                {Context::get().m_comm.translate_into_complex(new_comm).get_alias_id(),
-                 Context::get().r_manager.supported_comms_vector.size()});
-            Context::get().r_manager.supported_comms_vector.push_back(*supported_comm);
+            SupportedComm supported_comm(*newcomm, world_ranks);
+            for (int i = 0; i < n; i++)
+                if (failed_ranks.test(ranks[i]))
+                    supported_comm.set_failed(ranks[i]);
+            if (found)
+                Context::get().r_manager.add_to_supported_comms(
+                    {Context::get().m_comm.translate_into_complex(*newcomm).get_alias_id(),
+                     index});
+            Context::get().r_manager.supported_comms_vector.push_back(supported_comm);
         }
     }
 }
 
 int is_respawned()
 {
-    return Context::get().r_manager.is_respawned();
+    // Replicas run the program from the start like their primary
+    return Context::get().r_manager.is_respawned() && !Context::get().rep_manager.is_replica();
 }
 
 void add_critical(int rank)
@@ -145,4 +108,51 @@ void add_critical(int rank)
     }
     else
         Context::get().r_manager.add_to_respawn_list(rank);
+}
+
+void legio_checkpoint_register(void* buf, size_t size)
+{
+    if constexpr (!BuildOptions::with_restart)
+    {
+        assert(false && "Unsupported (recompile with restart)");
+    }
+    else
+        Context::get().c_manager.register_region(buf, size);
+}
+
+void* legio_checkpoint_alloc(size_t size)
+{
+    if constexpr (!BuildOptions::with_restart)
+    {
+        assert(false && "Unsupported (recompile with restart)");
+        return NULL;
+    }
+    else
+        return Context::get().c_manager.allocate_region(size);
+}
+
+void legio_checkpoint_commit()
+{
+    if constexpr (!BuildOptions::with_restart)
+    {
+        assert(false && "Unsupported (recompile with restart)");
+    }
+    else if (Context::get().rep_manager.is_shadowing())
+        Context::get().c_manager.skip_commit();
+    else
+    {
+        Context::get().c_manager.commit();
+        if constexpr (BuildOptions::message_logging)
+            Context::get().m_log.trim(Context::get().c_manager.get_generation());
+    }
+}
+
+int legio_checkpoint_generation()
+{
+    return Context::get().c_manager.get_generation();
+}
+
+size_t legio_checkpoint_bytes()
+{
+    return Context::get().c_manager.get_last_bytes();
 }
\ No newline at end of file
@@ -10,16 +10,12 @@ int RestartManager::untranslate_world_rank(int translated)
     // 1 2 3 4
     // 1 x 3 4
     // 2 = translated -> needs to become three
-    int source = translated;
-    for (int i = 0; i <= translated; i++)
-        if (ranks.at(i).failed)
-            source++;
-    return source;
+    return failed_ranks.select_unset(translated);
 }
 
 void RestartManager::set_failed_rank(int world_rank)
 {
-    ranks.at(world_rank).failed = true;
+    failed_ranks.set(world_rank);
     for (auto& supported_comm : supported_comms)
     {
         supported_comms_vector[supported_comm.second].set_failed(world_rank);
@@ -30,9 +26,6 @@ void RestartManager::set_failed_rank(int world_rank)
 int RestartManager::translate_ranks(int source_rank, ComplexComm& comm)
 {
     assert(initialized);
-    MPI_Group tr_group;
-    int source = source_rank;
-    int failed_ranks = 0;
     auto res = supported_comms.find(comm.get_alias_id());
     if (res == supported_comms.end() && comm.get_alias() != MPI_COMM_WORLD)
     {
@@ -40,20 +33,15 @@ int RestartManager::translate_ranks(int source_rank, ComplexComm& comm)
         int source = source_rank, dest_rank;
         MPI_Comm_group(comm.get_comm(), &tr_group);
         MPI_Group_translate_ranks(comm.get_group(), 1, &source, tr_group, &dest_rank);
+        MPI_Group_free(&tr_group);
         return dest_rank;
     }
     else if (comm.get_alias() == MPI_COMM_WORLD)
-    {
-        for (int i = 0; i < source_rank; i++)
-            if (ranks.at(i).failed)
-                failed_ranks++;
-        return source_rank - failed_ranks;
-    }
+        return source_rank - failed_ranks.count_before(source_rank);
     else
     {
-        SupportedComm respawned_comm = supported_comms_vector[res->second];
-        failed_ranks = respawned_comm.get_failed_ranks_before(source_rank);
-        return source_rank - failed_ranks;
+        const SupportedComm& respawned_comm = supported_comms_vector[res->second];
+        return source_rank - respawned_comm.get_failed_ranks_before(source_rank);
     }
 }
 
@@ -65,11 +53,7 @@ void RestartManager::initialize(const int size)
         return;
     initialized = true;
     respawned = false;
-    // Initialize ranks
-    for (int i = 0; i < size; i++)
-    {
-        ranks.push_back(Rank(i, false));
-    }
+    failed_ranks = PrefixRankBitset(size);
 };
 
 void RestartManager::initialize(const int size, const int rank_, const std::vector<int> failed)
@@ -81,11 +65,9 @@ void RestartManager::initialize(const int size, const int rank_, const std::vect
         return;
     initialized = true;
     respawned = true;
-    for (int i = 0; i < size; i++)
-    {
-        bool is_failed = std::count(failed.begin(), failed.end(), i) != 0;
-        ranks.push_back(Rank(i, is_failed));
-    }
+    failed_ranks = PrefixRankBitset(size);
+    for (auto failed_rank : failed)
+        failed_ranks.set(failed_rank);
     own_rank = rank_;
 }
 const bool RestartManager::is_initialized()
@@ -1,12 +1,15 @@
 #include "restart_routines.hpp"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <mutex>
-#include <shared_mutex>
 #include <sstream>
 #include <thread>
 #include <vector>
+#include "comm_manipulation.hpp"
 #include "complex_comm.hpp"
 #include "context.hpp"
+#include "log.hpp"
 #include "mpi.h"
 
 #include "mpi-ext.h"
@@ -17,43 +20,101 @@ extern "C" {
 
 using namespace legio;
 
-// Failure mutex is locked in shared mode when accessing normal MPI operations
-// When a restart operation is started, we need to lock it exclusively
-std::shared_timed_mutex failure_mtx;
+// Repairs are collective over the world, so they run one at a time; each of them locks
+// exclusively only the ComplexComms it replaces
+std::mutex repair_mtx;
 std::mutex change_world_mtx;
+// Ranks replaced together with this one, they take part in the checkpoint restore
+std::vector<int> respawned_together;
+// Thread waiting for the repair requests of the other ranks
+std::thread repair_listener;
+std::atomic<bool> stop_listener{false};
+
+std::vector<int> legio::encode_bootstrap_message(const int value,
+                                          const std::vector<int>& to_fill,
+                                          const std::vector<int>& failed,
+                                          const int world_size)
+{
+    const auto& respawn_list = Context::get().r_manager.get_respawn_list();
+    std::vector<int> message = {value, world_size};
+    const std::string& job_key = Context::get().c_manager.get_job_key();
+    message.reserve(6 + to_fill.size() + respawn_list.size() + failed.size() + job_key.size());
+    message.push_back(to_fill.size());
+    message.insert(message.end(), to_fill.begin(), to_fill.end());
+    message.push_back(respawn_list.size());
+    message.insert(message.end(), respawn_list.begin(), respawn_list.end());
+    message.push_back(failed.size());
+    message.insert(message.end(), failed.begin(), failed.end());
+    message.push_back(job_key.size());
+    message.insert(message.end(), job_key.begin(), job_key.end());
+    return message;
+}
+
+BootstrapState legio::decode_bootstrap_message(const std::vector<int>& message)
+{
+    BootstrapState state;
+    auto position = message.begin() + 1;
+    state.world_size = *(position++);
+    state.to_fill.assign(position + 1, position + 1 + *position);
+    position += 1 + *position;
+    state.respawn_list.assign(position + 1, position + 1 + *position);
+    position += 1 + *position;
+    state.failed.assign(position + 1, position + 1 + *position);
+    position += 1 + *position;
+    state.job_key.assign(position + 1, position + 1 + *position);
+    return state;
+}
 
 void legio::repair_failure()
 {
     // Failure repair procedure needed - for all ranks
-    int failed, ranks[LEGIO_MAX_FAILS], rank, original_world_size;
+    int rank, original_world_size, revoked = 0;
 
     MPI_Comm_size(MPI_COMM_WORLD, &original_world_size);
 
+    const std::lock_guard<std::mutex> serialized(repair_mtx);
     ComplexComm& world = Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD);
 
     // Ensure all failed ranks are acked
-    // MPIX_Comm_revoke(world->get_comm());
     MPIX_Comm_failure_ack(world.get_comm());
-    who_failed(world.get_comm(), &failed, ranks);
+    MPIX_Comm_is_revoked(world.get_comm(), &revoked);
 
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
-    if (failed == 0)
+    // A revoked world is repaired even if this rank has not detected the failure yet
+    if (!revoked && acked_failures(world.get_comm()).empty())
         return;
 
+    // Threads blocked on the world are woken up by its revoke, the ones using comms without
+    // failed ranks are not stopped
+    const std::lock_guard<ComplexComm> guard(world);
     MPI_Comm tmp_intracomm, tmp_intercomm, tmp_world, new_world;
 
+    // A checkpoint transfer still running would use the world after it is freed: the revoke
+    // makes it fail instead of waiting for peers that are repairing too
+    if (Context::get().c_manager.is_pending())
+    {
+        MPIX_Comm_revoke(world.get_comm());
+        Context::get().c_manager.wait_pending();
+    }
+
+    settle_failures(world.get_comm());
     PMPIX_Comm_shrink(world.get_comm(), &tmp_world);
 
-    // Transform the failed processes to world alias ranks
+    // The shrink agrees on the failed processes, transform them to world alias ranks
     std::vector<int> failed_world_ranks;
-    std::vector<Rank> world_ranks = Context::get().r_manager.get_ranks();
-    for (int i = 0; i < failed; i++)
-        failed_world_ranks.push_back(Context::get().r_manager.untranslate_world_rank(ranks[i]));
+    for (auto failed_rank : excluded_ranks(world.get_comm(), tmp_world))
+        failed_world_ranks.push_back(Context::get().r_manager.untranslate_world_rank(failed_rank));
+    if (failed_world_ranks.empty())
+    {
+        MPI_Comm_set_errhandler(tmp_world, MPI_ERRORS_RETURN);
+        world.replace_comm(tmp_world);
+        return;
+    }
 
     // Set the ranks as failed and gather to respawn
     std::vector<int> current_to_respawn;
-    auto respawn_list = Context::get().r_manager.get_respawn_list();
+    const auto& respawn_list = Context::get().r_manager.get_respawn_list();
     for (auto failed_world_rank : failed_world_ranks)
         if (std::find(respawn_list.begin(), respawn_list.end(), failed_world_rank) ==
             respawn_list.end())
@@ -63,154 +124,402 @@ void legio::repair_failure()
 
     // Create a list of failed ranks to pass as parameter
     std::vector<int> all_failed_ranks;
-    for (auto cur_rank : Context::get().r_manager.get_ranks())
-        if (cur_rank.failed)
-            all_failed_ranks.push_back(cur_rank.number);
-
-    // Re-generate all MPI_Comm_world for all the restarted processes
-    std::vector<char*> program_names;
-    std::vector<char**> argvs;
-    std::vector<int> max_procs;
-    std::vector<MPI_Info> infos;
-    char** newargv = (char**)malloc(sizeof(char*) * 10);
-    for (int i = 0; i < 10; i++)
-        newargv[i] = (char*)malloc(sizeof(char) * 30);
-
-    for (auto to_respawn : current_to_respawn)
-    {
-        sprintf(newargv[0], "--respawned");
-        sprintf(newargv[1], "--rank");
-        sprintf(newargv[2], "%d", to_respawn);
-        sprintf(newargv[3], "--size");
-        sprintf(newargv[4], "%d", original_world_size);
-        sprintf(newargv[5], "--to-respawn");
-        std::string separator;
-        std::ostringstream ss;
-        for (auto x : Context::get().r_manager.get_respawn_list())
+    const PrefixRankBitset& failed_ranks = Context::get().r_manager.get_failed_ranks();
+    for (int i = 0; i < failed_ranks.size(); i++)
+        if (failed_ranks.test(i))
+            all_failed_ranks.push_back(i);
+
+    // Promoted replicas carry on from the state of their primary, nothing to restore or replay
+    std::vector<int> promoted;
+    if constexpr (BuildOptions::replicate_critical)
+        if (current_to_respawn.size() != 0 &&
+            Context::get().rep_manager.promote(tmp_world, rank, current_to_respawn,
+                                               all_failed_ranks, original_world_size, &new_world))
         {
-            ss << separator << x;
-            separator = ",";
+            legio::log("Failed critical ranks replaced by their replicas", LogLevel::full);
+            promoted.swap(current_to_respawn);
         }
-        sprintf(newargv[6], "%s", ss.str().c_str());
 
-        if (Context::get().r_manager.get_ranks().size() != 0)
+    if (current_to_respawn.size() != 0 &&
+        repair_from_spare_pool(tmp_world, rank, current_to_respawn, all_failed_ranks,
+                               original_world_size, &new_world))
+        legio::log("Failed critical ranks replaced from the spare pool", LogLevel::full);
+    else if (current_to_respawn.size() != 0)
+    {
+        // Re-generate all MPI_Comm_world for all the restarted processes
+        char respawned_flag[] = "--respawned";
+        char* respawned_argv[] = {respawned_flag, NULL};
+        PMPI_Comm_spawn(program_invocation_name, respawned_argv, current_to_respawn.size(),
+                        MPI_INFO_NULL, 0, tmp_world, &tmp_intercomm, MPI_ERRCODES_IGNORE);
+        // The i-th spawned process takes the place of current_to_respawn[i]
+        std::vector<int> message = encode_bootstrap_message(
+            LEGIO_RESPAWN_VALUE, current_to_respawn, all_failed_ranks, original_world_size);
+        int tmp_rank, length = message.size();
+        PMPI_Comm_rank(tmp_world, &tmp_rank);
+        int root = tmp_rank == 0 ? MPI_ROOT : MPI_PROC_NULL;
+        PMPI_Bcast(&length, 1, MPI_INT, root, tmp_intercomm);
+        PMPI_Bcast(message.data(), length, MPI_INT, root, tmp_intercomm);
+        PMPI_Intercomm_merge(tmp_intercomm, 1, &tmp_intracomm);
+        PMPI_Comm_split(tmp_intracomm, 1, rank, &new_world);
+    }
+    else if (promoted.size() == 0)
+        new_world = tmp_world;
+
+    MPI_Comm_set_errhandler(new_world, MPI_ERRORS_RETURN);
+    world.replace_comm(new_world);
+
+    // Respawned ranks restore their checkpoint before re-creating their comms
+    if (current_to_respawn.size() != 0)
+        Context::get().c_manager.restore(current_to_respawn);
+
+    regenerate_supported_comms(rank, failed_world_ranks);
+
+    if constexpr (BuildOptions::replicate_critical)
+        if (promoted.size() != 0)
+            Context::get().rep_manager.resume(promoted);
+
+    if constexpr (BuildOptions::message_logging)
+        if (current_to_respawn.size() != 0)
+            Context::get().m_log.replay(current_to_respawn);
+}
+
+// Each creation only involves the members of the comm
+void legio::regenerate_supported_comms(const int rank, const std::vector<int>& changed)
+{
+    const auto& supported_comms = Context::get().r_manager.supported_comms_vector;
+    for (std::size_t index = 0; index < supported_comms.size(); index++)
+    {
+        const auto& entry = supported_comms[index];
+        const auto& world_ranks = entry.get_world_ranks();
+        if (std::none_of(changed.begin(), changed.end(), [&world_ranks](const int world_rank) {
+                return std::find(world_ranks.begin(), world_ranks.end(), world_rank) !=
+                       world_ranks.end();
+            }))
+            continue;
+        std::vector<int> alive_ranks;
+        for (std::size_t i = 0; i < world_ranks.size(); i++)
+            if (!entry.is_failed(i))
+                alive_ranks.push_back(world_ranks[i]);
+        if (std::find(alive_ranks.begin(), alive_ranks.end(), rank) == alive_ranks.end())
+            continue;
+
+        // Comms released with legio_unmanaged are not repaired
+        if (!Context::get().m_comm.part_of(entry.alias))
+            continue;
+        // The revoke wakes up the threads blocked on the comm, so that it can be locked
+        ComplexComm& complex = Context::get().m_comm.translate_into_complex(entry.alias);
+        MPIX_Comm_revoke(complex.get_comm());
+        const std::lock_guard<ComplexComm> guard(complex);
+        MPI_Comm new_comm = create_supported_comm(alive_ranks, index);
+        complex.replace_comm(new_comm);
+    }
+}
+
+MPI_Comm legio::create_supported_comm(const std::vector<int>& alive_world_ranks, const int tag)
+{
+    ComplexComm& world = Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD);
+    std::vector<int> translated;
+    translated.reserve(alive_world_ranks.size());
+    for (auto world_rank : alive_world_ranks)
+        translated.push_back(Context::get().r_manager.translate_ranks(world_rank, world));
+
+    MPI_Group world_group, new_group;
+    MPI_Comm new_comm;
+    PMPI_Comm_group(world.get_comm(), &world_group);
+    PMPI_Group_incl(world_group, translated.size(), translated.data(), &new_group);
+    PMPI_Comm_create_group(world.get_comm(), new_group, tag, &new_comm);
+    PMPI_Group_free(&new_group);
+    PMPI_Group_free(&world_group);
+    MPI_Comm_set_errhandler(new_comm, MPI_ERRORS_RETURN);
+    return new_comm;
+}
+
+// A receive stays posted on the current world and completes with an error once the world is
+// revoked by a detector; while idle the listener holds no lock and checks it with a backoff that
+// doubles up to REPAIR_POLL_MAX milliseconds
+void legio::loop_repair_failures()
+{
+    int buf, flag = 0, pause = 1;
+    MPI_Comm listened = MPI_COMM_NULL;
+    MPI_Request request = MPI_REQUEST_NULL;
+
+    while (!stop_listener)
+    {
+        change_world_mtx.lock();
+        MPI_Comm world_comm =
+            Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD).get_comm();
+        if (world_comm != listened || request == MPI_REQUEST_NULL)
         {
-            newargv[7] = NULL;
-            newargv[8] = NULL;
+            // The world was replaced meanwhile, the receive moves to the new one
+            if (request != MPI_REQUEST_NULL)
+            {
+                PMPI_Cancel(&request);
+                PMPI_Wait(&request, MPI_STATUS_IGNORE);
+            }
+            listened = world_comm;
+            if (listened != MPI_COMM_NULL)
+                PMPI_Irecv(&buf, 1, MPI_INT, MPI_ANY_SOURCE, LEGIO_FAILURE_TAG, listened,
+                           &request);
         }
-        else
+        change_world_mtx.unlock();
+        if (listened == MPI_COMM_NULL)
+            return;
+
+        int rc = PMPI_Test(&request, &flag, MPI_STATUS_IGNORE);
+        if (rc != MPI_SUCCESS)
         {
-            sprintf(newargv[7], "--failed-ranks");
-            std::string separator_failed_ranks;
-            std::ostringstream ss_failed_ranks;
-            for (auto x : all_failed_ranks)
+            int eclass;
+            MPI_Error_class(rc, &eclass);
+            if (eclass == MPIX_ERR_REVOKED)
             {
-                ss_failed_ranks << separator_failed_ranks << x;
-                separator_failed_ranks = ",";
+                // Another rank detected a failure and revoked the world
+                legio::log("Repair requested by another rank", LogLevel::full);
+                repair_failure();
+                pause = 1;
+                continue;
             }
-            sprintf(newargv[8], "%s", ss_failed_ranks.str().c_str());
+            // An unacknowledged failure stops any-source matching, a revoke is likely to follow
+            change_world_mtx.lock();
+            if (Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD).get_comm() ==
+                listened)
+                MPIX_Comm_failure_ack(listened);
+            change_world_mtx.unlock();
+            pause = 1;
+            continue;
         }
-        newargv[9] = NULL;
-        argvs.push_back(newargv);
-        program_names.push_back(program_invocation_name);
-        max_procs.push_back(1);
-        infos.push_back(MPI_INFO_NULL);
+        std::this_thread::sleep_for(std::chrono::milliseconds(pause));
+        pause = std::min(pause * 2, BuildOptions::repair_poll_max);
     }
 
-    for (int i = 0; i < 10; i++)
-        free(newargv[i]);
-    free(newargv);
-
-    if (current_to_respawn.size() != 0)
+    if (request != MPI_REQUEST_NULL)
     {
-        PMPI_Comm_spawn_multiple(current_to_respawn.size(), program_names.data(), argvs.data(),
-                                 max_procs.data(), infos.data(), 0, tmp_world, &tmp_intercomm,
-                                 NULL);
-        PMPI_Intercomm_merge(tmp_intercomm, 1, &tmp_intracomm);
-        PMPI_Comm_split(tmp_intracomm, 1, rank, &new_world);
+        PMPI_Cancel(&request);
+        PMPI_Wait(&request, MPI_STATUS_IGNORE);
     }
-    else
-        new_world = tmp_world;
+}
 
-    MPI_Comm_set_errhandler(new_world, MPI_ERRORS_RETURN);
-    change_world_mtx.lock();
-    Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD).replace_comm(new_world);
-    change_world_mtx.unlock();
+void legio::start_repair_listener()
+{
+    stop_listener = false;
+    repair_listener = std::thread(loop_repair_failures);
+}
 
-    MPI_Group group_world;
-    PMPI_Comm_group(new_world, &group_world);
-    ComplexComm& complex = Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD);
+void legio::stop_repair_listener()
+{
+    stop_listener = true;
+    if (repair_listener.joinable())
+        repair_listener.join();
+}
 
-    // Regenerate the supported comms
-    for (auto entry : Context::get().r_manager.supported_comms_vector)
+void legio::create_spare_pool(int argc, char** argv)
+{
+    // Spares run the same program, parking inside MPI_Init until promoted
+    std::vector<char*> spare_argv(argv + 1, argv + argc);
+    spare_argv.push_back(const_cast<char*>("--spare"));
+    spare_argv.push_back(NULL);
+    MPI_Comm pool;
+    ComplexComm& world = Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD);
+    int rc = PMPI_Comm_spawn(program_invocation_name, spare_argv.data(),
+                             BuildOptions::spare_pool_size, MPI_INFO_NULL, 0, world.get_comm(),
+                             &pool, MPI_ERRCODES_IGNORE);
+    if (rc != MPI_SUCCESS)
     {
-        auto world_ranks = entry.get_current_world_ranks();
-        // Get the group of current world ranks
-        std::vector<int> ranks_in_comm, ranks_in_comm_translated;
-        MPI_Group new_group;
-        MPI_Comm new_comm, alias_comm = entry.alias;
-
-        for (auto rank : world_ranks)
-            if (!rank.failed)
-                ranks_in_comm.push_back(rank.number);
-
-        // Translate the ranks according to current world
-        for (auto rank : ranks_in_comm)
+        legio::log("Unable to spawn the spare pool, respawn will be used", LogLevel::errors_only);
+        return;
+    }
+    MPI_Comm_set_errhandler(pool, MPI_ERRORS_RETURN);
+    Context::get().r_manager.set_spare_pool(pool);
+}
+
+void legio::release_spare_pool()
+{
+    MPI_Comm pool = Context::get().r_manager.get_spare_pool();
+    if (pool == MPI_COMM_NULL)
+        return;
+    int rank, pool_size, message = LEGIO_SPARE_RELEASE_VALUE;
+    PMPI_Comm_rank(pool, &rank);
+    PMPI_Comm_remote_size(pool, &pool_size);
+    if (rank == 0)
+        for (int i = 0; i < pool_size; i++)
+            PMPI_Send(&message, 1, MPI_INT, i, LEGIO_SPARE_TAG, pool);
+    PMPI_Comm_free(&pool);
+    Context::get().r_manager.set_spare_pool(MPI_COMM_NULL);
+}
+
+// Survivors side of the promotion: the spares replace the failed critical ranks and the ones not
+// needed are re-connected to the new world
+bool legio::repair_from_spare_pool(MPI_Comm tmp_world,
+                                   const int key,
+                                   const std::vector<int>& to_respawn,
+                                   const std::vector<int>& failed,
+                                   const int world_size,
+                                   MPI_Comm* new_world)
+{
+    MPI_Comm pool = Context::get().r_manager.get_spare_pool();
+    if (pool == MPI_COMM_NULL)
+        return false;
+    int tmp_rank, pool_size;
+    PMPI_Comm_rank(tmp_world, &tmp_rank);
+    PMPI_Comm_remote_size(pool, &pool_size);
+    int promoted = to_respawn.size();
+    if (pool_size < promoted)
+    {
+        // Not enough spares, release them and respawn from now on; rank 0 of the pool may be
+        // among the failed ones
+        if (tmp_rank == 0)
         {
-            int dest = Context::get().r_manager.translate_ranks(rank, complex);
-            ranks_in_comm_translated.push_back(dest);
+            int message = LEGIO_SPARE_RELEASE_VALUE;
+            for (int i = 0; i < pool_size; i++)
+                PMPI_Send(&message, 1, MPI_INT, i, LEGIO_SPARE_TAG, pool);
         }
+        PMPI_Comm_free(&pool);
+        Context::get().r_manager.set_spare_pool(MPI_COMM_NULL);
+        return false;
+    }
 
-        MPI_Group_incl(group_world, ranks_in_comm_translated.size(),
-                       ranks_in_comm_translated.data(), &new_group);
+    if (tmp_rank == 0)
+    {
+        std::vector<int> message =
+            encode_bootstrap_message(LEGIO_SPARE_REPAIR_VALUE, to_respawn, failed, world_size);
+        for (int i = 0; i < pool_size; i++)
+            PMPI_Send(message.data(), message.size(), MPI_INT, i, LEGIO_SPARE_TAG, pool);
+    }
 
-        PMPI_Comm_create(new_world, new_group, &new_comm);
-        MPI_Comm_set_errhandler(new_comm, MPI_ERRORS_RETURN);
-        Context::get().m_comm.translate_into_complex(alias_comm).replace_comm(new_comm);
+    MPI_Comm shrunk_pool, merged, new_pool = MPI_COMM_NULL;
+    int survivors, spares;
+    MPIX_Comm_shrink(pool, &shrunk_pool);
+    PMPI_Comm_free(&pool);
+    PMPI_Comm_size(shrunk_pool, &survivors);
+    PMPI_Comm_remote_size(shrunk_pool, &spares);
+    if (spares < promoted)
+    {
+        // Some spares failed meanwhile. The shrink gives the same sizes on both sides, so the
+        // spares left see it too and leave on their own
+        PMPI_Comm_free(&shrunk_pool);
+        Context::get().r_manager.set_spare_pool(MPI_COMM_NULL);
+        return false;
+    }
+    PMPI_Intercomm_merge(shrunk_pool, 0, &merged);
+    PMPI_Comm_split(merged, 1, key, new_world);
+    if (spares > promoted)
+    {
+        // The local leader is the survivor with rank 0 inside merged, known by the spares too
+        MPI_Group merged_group, world_group;
+        int zero = 0, leader;
+        PMPI_Comm_group(merged, &merged_group);
+        PMPI_Comm_group(*new_world, &world_group);
+        PMPI_Group_translate_ranks(merged_group, 1, &zero, world_group, &leader);
+        PMPI_Group_free(&merged_group);
+        PMPI_Group_free(&world_group);
+        PMPI_Intercomm_create(*new_world, leader, merged, survivors + promoted, LEGIO_SPARE_TAG,
+                              &new_pool);
+        MPI_Comm_set_errhandler(new_pool, MPI_ERRORS_RETURN);
     }
+    PMPI_Comm_free(&shrunk_pool);
+    PMPI_Comm_free(&merged);
+    PMPI_Comm_free(&tmp_world);
+    Context::get().r_manager.set_spare_pool(new_pool);
+    return true;
 }
 
-void legio::loop_repair_failures()
+MPI_Comm legio::wait_for_promotion()
 {
-    int rank;
-
+    MPI_Comm pool;
+    PMPI_Comm_get_parent(&pool);
+    MPI_Comm_set_errhandler(pool, MPI_ERRORS_RETURN);
     while (1)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(2000));
-        int length;
         MPI_Status status;
-        MPI_Comm world_comm;
-        change_world_mtx.lock();
+        int count;
+        int rc = PMPI_Probe(MPI_ANY_SOURCE, LEGIO_SPARE_TAG, pool, &status);
+        if (rc != MPI_SUCCESS)
+        {
+            // A process of the world failed, keep listening from the others
+            MPIX_Comm_failure_ack(pool);
+            continue;
+        }
+        PMPI_Get_count(&status, MPI_INT, &count);
+        std::vector<int> message(count);
+        PMPI_Recv(message.data(), count, MPI_INT, status.MPI_SOURCE, LEGIO_SPARE_TAG, pool,
+                  MPI_STATUS_IGNORE);
+        if (message[0] == LEGIO_SPARE_RELEASE_VALUE)
+        {
+            PMPI_Finalize();
+            exit(0);
+        }
 
-        ComplexComm& world = Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD);
-        world_comm = world.get_comm();
-        MPI_Comm_set_errhandler(world_comm, MPI_ERRORS_RETURN);
-        if (world_comm == MPI_COMM_NULL)
+        BootstrapState state = decode_bootstrap_message(message);
+        MPI_Comm shrunk_pool, merged, new_comm, new_pool = MPI_COMM_NULL;
+        int own, survivors, spares, promoted = state.to_fill.size();
+        MPIX_Comm_shrink(pool, &shrunk_pool);
+        PMPI_Comm_free(&pool);
+        PMPI_Comm_rank(shrunk_pool, &own);
+        PMPI_Comm_size(shrunk_pool, &spares);
+        PMPI_Comm_remote_size(shrunk_pool, &survivors);
+        if (spares < promoted)
         {
-            change_world_mtx.unlock();
-            return;
+            // Too few spares survived, the world respawns the failed ranks instead
+            PMPI_Comm_free(&shrunk_pool);
+            PMPI_Finalize();
+            exit(0);
         }
-        // printf("Probing from rank %d\n", rank);
-        int flag = 0, buf;
-        int local_rank;
-        PMPI_Iprobe(MPI_ANY_SOURCE, LEGIO_FAILURE_TAG, world_comm, &flag, MPI_STATUS_IGNORE);
-        if (flag)
+        PMPI_Intercomm_merge(shrunk_pool, 1, &merged);
+        bool selected = own < promoted;
+        PMPI_Comm_split(merged, selected ? 1 : 2, selected ? state.to_fill[own] : own, &new_comm);
+        if (spares > promoted)
         {
-            int rank, size;
-            MPI_Comm_size(MPI_COMM_WORLD, &size);
-            MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-            printf("\n\n\n%d FOUND SOMETHING TO REPAIR THROUGH THREAD!\n", rank);
-            PMPI_Recv(&buf, 1, MPI_INT, MPI_ANY_SOURCE, LEGIO_FAILURE_TAG, world_comm, &status);
-            change_world_mtx.unlock();
-            failure_mtx.lock();
-            repair_failure();
-            failure_mtx.unlock();
+            // Spares left are ranked by their shrunk rank, so the first one is the leader
+            if (selected)
+            {
+                MPI_Group merged_group, world_group;
+                int zero = 0, leader;
+                PMPI_Comm_group(merged, &merged_group);
+                PMPI_Comm_group(new_comm, &world_group);
+                PMPI_Group_translate_ranks(merged_group, 1, &zero, world_group, &leader);
+                PMPI_Group_free(&merged_group);
+                PMPI_Group_free(&world_group);
+                PMPI_Intercomm_create(new_comm, leader, merged, survivors + promoted,
+                                      LEGIO_SPARE_TAG, &new_pool);
+            }
+            else
+                PMPI_Intercomm_create(new_comm, 0, merged, 0, LEGIO_SPARE_TAG, &new_pool);
+            MPI_Comm_set_errhandler(new_pool, MPI_ERRORS_RETURN);
         }
-        else
-            change_world_mtx.unlock();
+        PMPI_Comm_free(&shrunk_pool);
+        PMPI_Comm_free(&merged);
+        if (selected)
+        {
+            respawned_together = state.to_fill;
+            Context::get().c_manager.set_job_key(state.job_key);
+            Context::get().r_manager.initialize(state.world_size, state.to_fill[own],
+                                                state.failed);
+            for (auto critical : state.respawn_list)
+                Context::get().r_manager.add_to_respawn_list(critical);
+            Context::get().r_manager.set_spare_pool(new_pool);
+            return new_comm;
+        }
+        PMPI_Comm_free(&new_comm);
+        pool = new_pool;
     }
 }
 
+void legio::receive_respawn_state()
+{
+    MPI_Comm parent;
+    int own, length;
+    PMPI_Comm_get_parent(&parent);
+    PMPI_Comm_rank(parent, &own);
+    PMPI_Bcast(&length, 1, MPI_INT, 0, parent);
+    std::vector<int> message(length);
+    PMPI_Bcast(message.data(), length, MPI_INT, 0, parent);
+    BootstrapState state = decode_bootstrap_message(message);
+    respawned_together = state.to_fill;
+    Context::get().c_manager.set_job_key(state.job_key);
+    Context::get().r_manager.initialize(state.world_size, state.to_fill[own], state.failed);
+    for (auto critical : state.respawn_list)
+        Context::get().r_manager.add_to_respawn_list(critical);
+}
+
 void legio::restart(int rank)
 {
     // Restart and re-construct MPI_COMM_WORLD
@@ -225,4 +534,10 @@ void legio::restart(int rank)
     MPI_Comm_set_errhandler(new_world, MPI_ERRORS_RETURN);
     // Reassign world with the merged comm
     Context::get().m_comm.translate_into_complex(MPI_COMM_WORLD).replace_comm(new_world);
-}
\ No newline at end of file
+    restore_checkpoint();
+}
+
+void legio::restore_checkpoint()
+{
+    Context::get().c_manager.restore(respawned_together);
+}
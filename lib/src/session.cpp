@@ -1,16 +1,15 @@
 #include <signal.h>
 #include <future>
-#include <shared_mutex>
 #include <thread>
 #include "comm_manipulation.hpp"
 #include "complex_comm.hpp"
 #include "context.hpp"
 #include "intercomm_utils.hpp"
 #include "log.hpp"
+#include "mpi-ext.h"
 #include "mpi.h"
 #include "restart_routines.hpp"
 
-extern std::shared_timed_mutex failure_mtx;
 using namespace legio;
 
 #if WITH_SESSION
@@ -42,24 +41,9 @@ int MPI_Session_init(MPI_Info info, MPI_Errhandler errhandler, MPI_Session* sess
         else
             PMPI_Session_init(MPI_INFO_NULL, MPI_ERRORS_RETURN, &temp);
         PMPI_Group_from_session_pset(temp, "mpi://WORLD", &group);
-        Context::get().s_manager.initialize();
+        Context::get().s_manager.initialize(group);
         if constexpr (BuildOptions::session_thread)
-        {
-            std::future<int>* hThread =
-                new std::future<int>(std::async(std::launch::async, [group] {
-                    MPI_Comm temp;
-                    int rc = PMPI_Comm_create_from_group(group, "Legio_horizon_construction",
-                                                         MPI_INFO_NULL, MPI_ERRORS_RETURN, &temp);
-                    Context::get().s_manager.add_horizon_comm(temp);
-                    return rc;
-                }));
-            if (hThread->wait_for(std::chrono::seconds(5)) == std::future_status::timeout)
-            {
-                printf("Not all processes reachable during first init, aborting\n");
-                exit(-1);
-            }
-        }
-        PMPI_Group_free(&group);
+            Context::get().s_manager.start_horizon_construction();
         Context::get().s_manager.add_pending_session(temp);
     }
     int rc = PMPI_Session_init(info, errhandler, session);
@@ -74,30 +58,29 @@ int MPI_Comm_create_from_group(MPI_Group group,
                                MPI_Comm* newcomm)
 {
     int rc;
-    failure_mtx.lock_shared();
     {
         MPI_Group clean;
         MPI_Comm horizon = Context::get().s_manager.get_horizon_comm(group);
         if (horizon != MPI_COMM_NULL)
+        {
+            // Horizons are never replaced, so there is no point where all the members could
+            // drop a cached group together: the group is checked every time
             check_group(horizon, group, &clean);
+            rc = PMPI_Comm_create_from_group(clean, stringtag, info, errhandler, newcomm);
+            PMPI_Group_free(&clean);
+            legio::report_execution(rc, horizon, "Comm_create_from_group");
+        }
         else
         {
             legio::log("Executing MPI_Comm_create_from_group in unsafe mode, it can deadlock",
                        LogLevel::errors_and_info);
-            clean = group;
-        }
-        rc = PMPI_Comm_create_from_group(clean, stringtag, info, errhandler, newcomm);
-        if (horizon != MPI_COMM_NULL)
-            legio::report_execution(rc, horizon, "Comm_create_from_group");
-        else
-        {
+            rc = PMPI_Comm_create_from_group(group, stringtag, info, errhandler, newcomm);
             MPI_Comm temp;
             PMPI_Comm_dup(*newcomm, &temp);
             Context::get().s_manager.add_horizon_comm(temp);
             legio::report_execution(rc, temp, "Comm_create_from_group");
         }
     }
-    failure_mtx.unlock_shared();
     if (rc == MPI_SUCCESS && *newcomm != MPI_COMM_NULL)
     {
         Context::get().m_comm.add_comm(*newcomm);
@@ -2,68 +2,120 @@
 #include <assert.h>
 #include <stdio.h>
 #include <algorithm>
+#include <chrono>
 #include <functional>
+#include <future>
 #include <mutex>
+#include <numeric>
 #include <stdexcept>
 #include <unordered_map>
 #include "complex_comm.hpp"
+#include "config.hpp"
+#include "log.hpp"
 #include "mpi.h"
 
 using namespace legio;
 
+RankBitset SessionManager::to_bitset(MPI_Group group)
+{
+    int world_size, size;
+    PMPI_Group_size(world_group, &world_size);
+    PMPI_Group_size(group, &size);
+    std::vector<int> ranks(size), world_ranks(size);
+    std::iota(ranks.begin(), ranks.end(), 0);
+    PMPI_Group_translate_ranks(group, size, ranks.data(), world_group, world_ranks.data());
+    RankBitset result(world_size);
+    for (auto rank : world_ranks)
+        if (rank != MPI_UNDEFINED)
+            result.set(rank);
+    return result;
+}
+
+void SessionManager::start_horizon_construction()
+{
+    MPI_Group group = world_group;
+    const std::lock_guard<std::mutex> lock(construction_lock);
+    construction = std::async(std::launch::async, [group] {
+                       MPI_Comm horizon;
+                       int rc = PMPI_Comm_create_from_group(group, "Legio_horizon_construction",
+                                                            MPI_INFO_NULL, MPI_ERRORS_RETURN,
+                                                            &horizon);
+                       return (rc == MPI_SUCCESS ? horizon : MPI_COMM_NULL);
+                   }).share();
+}
+
+bool SessionManager::wait_horizon_construction(const bool join)
+{
+    std::shared_future<MPI_Comm> pending;
+    {
+        const std::lock_guard<std::mutex> lock(construction_lock);
+        if (!construction.valid())
+            return true;
+        pending = construction;
+    }
+    if (join)
+        pending.wait();
+    else if (pending.wait_for(std::chrono::milliseconds(BuildOptions::horizon_timeout)) ==
+             std::future_status::timeout)
+        return false;
+    // The construction is only marked as done once the horizon is registered, so that the
+    // threads returning here after another one find it
+    const std::lock_guard<std::mutex> lock(construction_lock);
+    if (!construction.valid())
+        return true;  // Already registered by another thread
+    MPI_Comm horizon = pending.get();
+    if (horizon != MPI_COMM_NULL)
+        add_horizon_comm(horizon);
+    construction = std::shared_future<MPI_Comm>();
+    return true;
+}
+
 MPI_Comm SessionManager::get_horizon_comm(MPI_Group group)
 {
-    const std::lock_guard<std::mutex> lock(horizon_lock);
-    for (auto horizon : horizon_comms)
+    if (!wait_horizon_construction(false))
     {
-        MPI_Group horizon_group, diff;
-        int size;
-        PMPI_Comm_group(horizon, &horizon_group);
-        PMPI_Group_difference(group, horizon_group, &diff);
-        PMPI_Group_size(diff, &size);
-        PMPI_Group_free(&horizon_group);
-        PMPI_Group_free(&diff);
-        if (!size)
-            return horizon;
+        // The caller goes on in unsafe mode, the horizon is registered once it is built
+        legio::log("Horizon communicator not built within HORIZON_TIMEOUT, going on without it",
+                   LogLevel::errors_only);
+        return MPI_COMM_NULL;
     }
+    RankBitset requested = to_bitset(group);
+    const std::lock_guard<std::mutex> lock(horizon_lock);
+    auto indexed = horizon_index.find(requested);
+    if (indexed != horizon_index.end())
+        return indexed->second;
+    // Horizons are sorted by size, the first one covering the group is the smallest
+    for (auto& horizon : horizon_comms)
+        if (horizon.members.count() >= requested.count() && horizon.members.contains(requested))
+        {
+            horizon_index.emplace(requested, horizon.comm);
+            return horizon.comm;
+        }
     return MPI_COMM_NULL;
 }
 
 void SessionManager::add_horizon_comm(MPI_Comm comm)
 {
+    MPI_Group comm_group;
+    PMPI_Comm_group(comm, &comm_group);
+    Horizon added = {comm, to_bitset(comm_group)};
+    PMPI_Group_free(&comm_group);
+
     const std::lock_guard<std::mutex> lock(horizon_lock);
-    std::list<MPI_Comm> new_horizon;
-    for (std::list<MPI_Comm>::iterator horizon = horizon_comms.begin();
-         horizon != horizon_comms.end(); horizon++)
-    {
-        MPI_Group horizon_group, comm_group, diff_hc, diff_ch;
-        int size_hc, size_ch;
-        PMPI_Comm_group(*horizon, &horizon_group);
-        PMPI_Comm_group(comm, &comm_group);
-        PMPI_Group_difference(horizon_group, comm_group, &diff_hc);
-        PMPI_Group_difference(comm_group, horizon_group, &diff_ch);
-        PMPI_Group_size(diff_hc, &size_hc);
-        PMPI_Group_size(diff_ch, &size_ch);
-        PMPI_Group_free(&horizon_group);
-        PMPI_Group_free(&comm_group);
-        PMPI_Group_free(&diff_hc);
-        PMPI_Group_free(&diff_ch);
-        if (!size_ch)
-        {
-            // Group is contained by the horizon
-            new_horizon.splice(new_horizon.end(), horizon_comms, horizon, horizon_comms.end());
-            horizon_comms = new_horizon;
-            return;
-        }
-        if (size_hc)
-        {
-            // Horizon is not contained by group
-            new_horizon.push_back(*horizon);
-        }
-    }
-    new_horizon.push_back(comm);
-    horizon_comms = new_horizon;
-    return;
+    for (auto& horizon : horizon_comms)
+        if (horizon.members.contains(added.members))
+            return;  // Group is contained by the horizon
+
+    // Drop horizons contained by the group, then insert keeping the order by size
+    horizon_comms.remove_if(
+        [&added](const Horizon& horizon) { return added.members.contains(horizon.members); });
+    auto position = std::find_if(horizon_comms.begin(), horizon_comms.end(),
+                                 [&added](const Horizon& horizon) {
+                                     return horizon.members.count() > added.members.count();
+                                 });
+    horizon_comms.insert(position, added);
+    // A smaller horizon may now cover the groups indexed, or one of them was dropped
+    horizon_index.clear();
 }
 
 void SessionManager::add_pending_session(MPI_Session session)
@@ -82,14 +134,19 @@ void SessionManager::close_session()
     open_sessions--;
     if (open_sessions == 0)
     {
+        // The background construction must not be using the group or the session anymore
+        wait_horizon_construction(true);
+        if (world_group != MPI_GROUP_NULL)
+            PMPI_Group_free(&world_group);
         for (auto session : pending)
             PMPI_Session_finalize(&session);
     }
 }
 
-void SessionManager::initialize()
+void SessionManager::initialize(MPI_Group world)
 {
     std::unique_lock<std::mutex> lock(init_lock);
+    world_group = world;
     initialized = true;
 }
 
@@ -1,4 +1,5 @@
 #include "supported_comm.hpp"
+#include <algorithm>
 #include "comm_manipulation.hpp"
 #include "complex_comm.hpp"
 #include "context.hpp"
@@ -7,40 +8,27 @@
 
 using namespace legio;
 
-Rank::Rank(int number_, bool failed_)
+SupportedComm::SupportedComm(MPI_Comm alias_, std::vector<int> world_ranks_)
+    : alias(alias_), world_ranks(world_ranks_), failed(world_ranks_.size())
 {
-    number = number_;
-    failed = failed_;
 }
 
-SupportedComm::SupportedComm(MPI_Comm alias_, std::vector<Rank> world_ranks_)
+void SupportedComm::set_failed(int world_rank)
 {
-    alias = alias_;
-    world_ranks = world_ranks_;
+    auto position = std::find(world_ranks.begin(), world_ranks.end(), world_rank);
+    if (position != world_ranks.end())
+        failed.set(position - world_ranks.begin());
 }
 
-int RespawnedSupportedComm::size()
+int RespawnedSupportedComm::size() const
 {
     return world_ranks.size();
 }
 
-int RespawnedSupportedComm::rank()
+int RespawnedSupportedComm::rank() const
 {
-    int rank, dest;
-    int size = RespawnedSupportedComm::size();
+    int rank;
     MPI_Comm_rank(get_alias(), &rank);
 
     return translate_ranks(rank, Context::get().m_comm.translate_into_complex(alias));
 }
-
-int SupportedComm::get_failed_ranks_before(int rank)
-{
-    int failed = 0;
-    for (int i = 0; i < rank; i++)
-    {
-        if (world_ranks.at(i).failed)
-            failed++;
-    }
-    // Cache it and clean the cache after
-    return failed;
-}